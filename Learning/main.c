@@ -2,6 +2,27 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#if defined(SEARCH_STATS) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+#include "sara.h"
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
 
 // FEN dedug positions
 #define empty_board "8/8/8/8/8/8/8/8 w - - "
@@ -89,20 +110,23 @@ const char* pos1D_to_notation[] = {
   "a8", "b8", "c8", "d8", "e8", "f8", "g8", "h8" 
 };
 
-uint64_t piece_bitboards[12];
+// board state is thread local so every search thread plays on its own board
+// while the attack tables below stay shared and read only
+
+_Thread_local uint64_t piece_bitboards[12];
 
 // white black white_black
-uint64_t piece_color_mask[3];
+_Thread_local uint64_t piece_color_mask[3];
 
 // side to move
-int side;
+_Thread_local int side;
 
 // enpassant 
-int enpassant_pos1D = out_of_bounds_pos1D;
+_Thread_local int enpassant_pos1D = out_of_bounds_pos1D;
 
 // castling rights
 enum { wck = 1, wcq = 2, bck = 4, bcq = 8 };
-int castle;
+_Thread_local int castle;
 /*
 0001 -> white king can castle to the king side
 0010 -> white king can castle to the queen side
@@ -110,6 +134,9 @@ int castle;
 1000 -> black king can castle to the queen side
 */
 
+// half moves since the last capture or pawn move (fifty move rule)
+_Thread_local int halfmove_clock;
+
 const int bishop_occupancy_setbits[] = {
   6,  5,  5,  5,  5,  5,  5,  6, 
   5,  5,  5,  5,  5,  5,  5,  5, 
@@ -384,6 +411,70 @@ uint64_t random_U64_number_low_population() {
   return random_U64_number() & random_U64_number() & random_U64_number();
 }
 
+// =====================
+// Zobrist Hashing
+// =====================
+
+// random keys [piece][pos1D]
+uint64_t piece_keys[12][64];
+
+// random enpassant keys [pos1D]
+uint64_t enpassant_keys[64];
+
+// random castling keys [castle]
+uint64_t castle_keys[16];
+
+// random side key (hashed in when black is to move)
+uint64_t side_key;
+
+// hash key of the current position
+_Thread_local uint64_t hash_key;
+
+/*
+  keys of the positions before each move of the game and of the search
+  path, make_move pushes and take_back pops by restoring the count. it's a
+  ring buffer indexed by key_history_count, repetition scans never reach
+  further back than the last irreversible move
+*/
+#define key_history_size 1024
+
+_Thread_local uint64_t key_history[key_history_size];
+_Thread_local int key_history_count;
+
+// plies since the last null move (or since the position was set up), repetitions aren't searched across it
+_Thread_local int plies_from_null;
+
+// key of the position distance plies ago
+#define key_history_at(distance) (key_history[(key_history_count - (distance)) & (key_history_size - 1)])
+
+// remember the current key before a move (or null move) changes it
+static inline void push_key_history() {
+  key_history[key_history_count & (key_history_size - 1)] = hash_key;
+  ++key_history_count;
+}
+
+// generate hash key of the current position from scratch
+uint64_t generate_hash_key() {
+  uint64_t key = 0ULL;
+
+  for (int piece = P; piece <= k; ++piece) {
+    uint64_t bitboard = piece_bitboards[piece];
+    while (bitboard) {
+      int pos1D = LSB_index(bitboard);
+      key ^= piece_keys[piece][pos1D];
+      reset_bit(&bitboard, pos1D);
+    }
+  }
+
+  if (enpassant_pos1D != out_of_bounds_pos1D) key ^= enpassant_keys[enpassant_pos1D];
+
+  key ^= castle_keys[castle];
+
+  if (side == black) key ^= side_key;
+
+  return key;
+}
+
 // =====================
 // Print 
 // =====================
@@ -525,6 +616,10 @@ void parse_FEN(char* fen) {
     enpassant_pos1D = out_of_bounds_pos1D;
   }
 
+  // half move clock (optional, the full move number isn't needed)
+  while (*fen && *fen != ' ') ++fen;
+  halfmove_clock = atoi(fen);
+
   // setting up occupancy masks
   for (int piece = P; piece <= K; ++piece) {
     piece_color_mask[white] |= piece_bitboards[piece];
@@ -533,8 +628,129 @@ void parse_FEN(char* fen) {
     piece_color_mask[black] |= piece_bitboards[piece];
   }
   piece_color_mask[white_black] |= (piece_color_mask[white] | piece_color_mask[black]);
+
+  // hash key of the parsed position, no history before it
+  hash_key = generate_hash_key();
+  key_history_count = 0;
+  plies_from_null = 0;
+}
+
+// =====================
+// Statistics
+// =====================
+
+/*
+  compile with -DSEARCH_STATS to count where the search spends its nodes
+  and time. every thread counts into its own stats, search_position merges
+  them into total_stats when it returns and the caller prints the report.
+  without SEARCH_STATS the stat_ macros expand to nothing
+*/
+
+#ifdef SEARCH_STATS
+
+typedef struct {
+  uint64_t main_nodes, quiescence_nodes;
+
+  uint64_t tt_probes, tt_hits, tt_cutoffs;
+
+  // index of the move that failed high (last slot is 7 and later)
+  uint64_t beta_cutoffs, cutoff_index[8];
+
+  uint64_t null_move_tries, null_move_cutoffs;
+
+  uint64_t generations, generated_moves;
+
+  uint64_t rook_attacks, bishop_attacks, square_attacked;
+
+  uint64_t makes, evaluations;
+  uint64_t material_probes, material_hits;
+  uint64_t generate_cycles, make_cycles, evaluate_cycles;
+} search_statistics;
+
+_Thread_local search_statistics stats;
+
+search_statistics total_stats;
+pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// time stamp counter, nanoseconds where there is none
+static inline uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
 }
 
+#define stat_add(field, value) (stats.field += (value))
+#define stat_timer_start() uint64_t stat_timer = read_cycles()
+#define stat_timer_stop(field) (stats.field += read_cycles() - stat_timer)
+
+// add the counters of the calling thread to total_stats
+void stats_merge() {
+  uint64_t* total = (uint64_t*)&total_stats;
+  uint64_t* local = (uint64_t*)&stats;
+
+  pthread_mutex_lock(&stats_mutex);
+  for (size_t i = 0; i < sizeof(search_statistics) / sizeof(uint64_t); ++i) total[i] += local[i];
+  pthread_mutex_unlock(&stats_mutex);
+
+  memset(&stats, 0, sizeof(stats));
+}
+
+static inline double percent(const uint64_t part, const uint64_t whole) {
+  return whole ? 100.0 * part / whole : 0.0;
+}
+
+static inline double ratio(const uint64_t part, const uint64_t whole) {
+  return whole ? (double)part / whole : 0.0;
+}
+
+// print total_stats, every line starts with prefix (e.g. "info string "), and reset them
+void print_stats_report(const char* prefix) {
+  search_statistics* s = &total_stats;
+  uint64_t all_nodes = s->main_nodes + s->quiescence_nodes;
+
+  printf("%ssearch statistics\n", prefix);
+  printf("%snodes %llu main %.1f%% quiescence %.1f%%\n", prefix, (unsigned long long)all_nodes,
+    percent(s->main_nodes, all_nodes), percent(s->quiescence_nodes, all_nodes));
+  printf("%stt probes %llu hits %.1f%% cutoffs %.1f%%\n", prefix, (unsigned long long)s->tt_probes,
+    percent(s->tt_hits, s->tt_probes), percent(s->tt_cutoffs, s->tt_probes));
+
+  printf("%sbeta cutoffs %llu by move", prefix, (unsigned long long)s->beta_cutoffs);
+  for (int i = 0; i < 8; ++i) printf(" %d%s %.1f%%", i + 1, (i == 7) ? "+" : "", percent(s->cutoff_index[i], s->beta_cutoffs));
+  printf("\n");
+
+  printf("%snull move tries %llu cutoffs %.1f%%\n", prefix, (unsigned long long)s->null_move_tries,
+    percent(s->null_move_cutoffs, s->null_move_tries));
+  printf("%smove generation calls %llu moves per call %.1f moves per node %.1f\n", prefix, (unsigned long long)s->generations,
+    ratio(s->generated_moves, s->generations), ratio(s->generated_moves, all_nodes));
+  printf("%sattack lookups rook %llu bishop %llu is_square_attacked %llu\n", prefix,
+    (unsigned long long)s->rook_attacks, (unsigned long long)s->bishop_attacks, (unsigned long long)s->square_attacked);
+  printf("%smaterial hash probes %llu hits %.1f%%\n", prefix, (unsigned long long)s->material_probes,
+    percent(s->material_hits, s->material_probes));
+  printf("%scycles per call generate %.0f make %.0f evaluate %.0f\n", prefix,
+    ratio(s->generate_cycles, s->generations), ratio(s->make_cycles, s->makes), ratio(s->evaluate_cycles, s->evaluations));
+
+  uint64_t timed_cycles = s->generate_cycles + s->make_cycles + s->evaluate_cycles;
+  printf("%scycles share generate %.1f%% make %.1f%% evaluate %.1f%%\n", prefix,
+    percent(s->generate_cycles, timed_cycles), percent(s->make_cycles, timed_cycles), percent(s->evaluate_cycles, timed_cycles));
+
+  memset(&total_stats, 0, sizeof(total_stats));
+}
+
+#else
+
+#define stat_add(field, value) ((void)0)
+#define stat_timer_start()
+#define stat_timer_stop(field) ((void)0)
+
+static inline void stats_merge() {}
+static inline void print_stats_report(const char* prefix) {}
+
+#endif
+
 // =====================
 // Attacks
 // =====================
@@ -890,6 +1106,8 @@ uint64_t magic_number(const int pos1D, const int occupancy_mask_setbits, const i
 
 // get bishop attacks
 static inline uint64_t get_bishop_attacks(int pos1D, uint64_t occupancy) {
+  stat_add(bishop_attacks, 1);
+
   uint64_t rel_occupancy = occupancy & bishop_masks[pos1D];
   int hash_index = (int)((rel_occupancy * bishop_magic_numbers[pos1D]) >> (64 - bishop_occupancy_setbits[pos1D]));
 
@@ -898,6 +1116,8 @@ static inline uint64_t get_bishop_attacks(int pos1D, uint64_t occupancy) {
 
 // get rook attacks
 static inline uint64_t get_rook_attacks(int pos1D, uint64_t occupancy) {
+  stat_add(rook_attacks, 1);
+
   uint64_t rel_occupancy = occupancy & rook_masks[pos1D];
   int hash_index = (int)((rel_occupancy * rook_magic_numbers[pos1D]) >> (64 - rook_occupancy_setbits[pos1D]));
 
@@ -909,12 +1129,120 @@ static inline uint64_t get_queen_attacks(int pos1D, uint64_t occupancy) {
   return get_bishop_attacks(pos1D, occupancy) | get_rook_attacks(pos1D, occupancy);
 }
 
+// =====================
+// Move Encoding
+// =====================
+
+/*
+  a move is packed into a single int
+
+  0000 0000 0000 0000 0011 1111    source square       0x3f
+  0000 0000 0000 1111 1100 0000    destination square  0xfc0
+  0000 0000 1111 0000 0000 0000    piece               0xf000
+  0000 1111 0000 0000 0000 0000    promoted piece      0xf0000
+  0001 0000 0000 0000 0000 0000    capture flag        0x100000
+  0010 0000 0000 0000 0000 0000    double push flag    0x200000
+  0100 0000 0000 0000 0000 0000    enpassant flag      0x400000
+  1000 0000 0000 0000 0000 0000    castling flag       0x800000
+
+  promoted piece 0 means no promotion (a pawn can never be promoted to a pawn)
+*/
+
+#define encode_move(source, destination, piece, promoted, capture, double_push, enpassant, castling) \
+  ((source) | ((destination) << 6) | ((piece) << 12) | ((promoted) << 16) | \
+  ((capture) << 20) | ((double_push) << 21) | ((enpassant) << 22) | ((castling) << 23))
+
+#define get_move_source(move) ((move) & 0x3f)
+#define get_move_destination(move) (((move) & 0xfc0) >> 6)
+#define get_move_piece(move) (((move) & 0xf000) >> 12)
+#define get_move_promoted(move) (((move) & 0xf0000) >> 16)
+#define get_move_capture(move) ((move) & 0x100000)
+#define get_move_double_push(move) ((move) & 0x200000)
+#define get_move_enpassant(move) ((move) & 0x400000)
+#define get_move_castling(move) ((move) & 0x800000)
+
+// promoted piece to uci character
+char promoted_pieces[] = {
+  [Q] = 'q',
+  [R] = 'r',
+  [B] = 'b',
+  [N] = 'n',
+  [q] = 'q',
+  [r] = 'r',
+  [b] = 'b',
+  [n] = 'n'
+};
+
+// move list
+typedef struct {
+  int moves[256];
+  int count;
+} moves;
+
+// add move to move list
+static inline void add_move(moves* move_list, const int move) {
+  move_list->moves[move_list->count] = move;
+  ++move_list->count;
+}
+
+// is move in move list
+static inline int move_in_list(const moves* move_list, const int move) {
+  for (int i = 0; i < move_list->count; ++i) {
+    if (move_list->moves[i] == move) return 1;
+  }
+
+  return 0;
+}
+
+// print move in uci notation (e.g. e7e8q)
+void print_move(const int move) {
+  if (get_move_promoted(move)) {
+    printf("%s%s%c", pos1D_to_notation[get_move_source(move)], pos1D_to_notation[get_move_destination(move)], promoted_pieces[get_move_promoted(move)]);
+  }
+  else {
+    printf("%s%s", pos1D_to_notation[get_move_source(move)], pos1D_to_notation[get_move_destination(move)]);
+  }
+}
+
+// move in uci notation (e.g. e7e8q), buffer needs 6 chars
+char* move_to_string(const int move, char* buffer) {
+  if (move == 0) {
+    strcpy(buffer, "0000");
+  }
+  else if (get_move_promoted(move)) {
+    sprintf(buffer, "%s%s%c", pos1D_to_notation[get_move_source(move)], pos1D_to_notation[get_move_destination(move)], promoted_pieces[get_move_promoted(move)]);
+  }
+  else {
+    sprintf(buffer, "%s%s", pos1D_to_notation[get_move_source(move)], pos1D_to_notation[get_move_destination(move)]);
+  }
+  return buffer;
+}
+
+// print move list
+void print_move_list(const moves* move_list) {
+  printf("\n    move    piece   capture   double   enpassant   castling\n\n");
+  for (int i = 0; i < move_list->count; ++i) {
+    int move = move_list->moves[i];
+    printf("    ");
+    print_move(move);
+    printf("%s   %c       %d         %d        %d           %d\n", get_move_promoted(move) ? "" : " ",
+      ascii_pieces[get_move_piece(move)],
+      get_move_capture(move) ? 1 : 0,
+      get_move_double_push(move) ? 1 : 0,
+      get_move_enpassant(move) ? 1 : 0,
+      get_move_castling(move) ? 1 : 0);
+  }
+  printf("\n    Total moves: %d\n\n", move_list->count);
+}
+
 // =====================
 // Move Generation
 // =====================
 
 // is square attacked by the given side
 static inline int is_square_attacked(int pos1D, int side) {
+  stat_add(square_attacked, 1);
+
   // if square is attacked by white pawns
   if ((side == white) && (pawn_attacks[black][pos1D] & piece_bitboards[P])) return 1;
 
@@ -933,7 +1261,7 @@ static inline int is_square_attacked(int pos1D, int side) {
   // if square is attacked by rook
   if (get_rook_attacks(pos1D, piece_color_mask[white_black]) & ((side == white) ? piece_bitboards[R] : piece_bitboards[r])) return 1;
 
-  // if square is attacked by queen  
+  // if square is attacked by queen
   if (get_queen_attacks(pos1D, piece_color_mask[white_black]) & ((side == white) ? piece_bitboards[Q] : piece_bitboards[q])) return 1;
 
 
@@ -946,138 +1274,7095 @@ void print_attacked_squares(int side) {
     printf("    %d  ", rank + 1);
     for (int file = 0; file < 8; ++file) {
       int pos1D = rank*8 + file;
-      printf(" %d", is_square_attacked(pos1D, side) ? 1 : 0); 
+      printf(" %d", is_square_attacked(pos1D, side) ? 1 : 0);
     }
     printf("\n");
   }
   printf("\n        a b c d e f g h\n");
 }
 
-void move_generation() {
-  int source_square, destination_square;
+// add quiet moves and captures of a non pawn piece given its attacks mask
+static inline void add_piece_moves(moves* move_list, const int piece, const int source_square, uint64_t attacks) {
+  // can't land on own pieces
+  attacks &= ~piece_color_mask[side];
 
-  uint64_t temp_piece_bitboard, temp_piece_attack;
+  while (attacks) {
+    int destination_square = LSB_index(attacks);
 
-  for (int piece = P; piece <= k; ++piece) {
-    temp_piece_bitboard = piece_bitboards[piece];
-    
+    // quiet move
+    if (!get_bit(piece_color_mask[side ^ 1], destination_square)) {
+      add_move(move_list, encode_move(source_square, destination_square, piece, 0, 0, 0, 0, 0));
+    }
+    // capture
+    else {
+      add_move(move_list, encode_move(source_square, destination_square, piece, 0, 1, 0, 0, 0));
+    }
+
+    reset_bit(&attacks, destination_square);
   }
 }
 
-// =====================
-// Init 
-// =====================
-
-void init_magic_numbers() {
-  printf("Rook \n");
-  for (int pos1D = 0; pos1D < 64; pos1D++) {
-    printf("0x%llxULL,\n", magic_number(pos1D, rook_occupancy_setbits[pos1D], 0));
+// add all four promotions of a pawn move
+static inline void add_promotions(moves* move_list, const int piece, const int source_square, const int destination_square, const int capture) {
+  if (side == white) {
+    add_move(move_list, encode_move(source_square, destination_square, piece, Q, capture, 0, 0, 0));
+    add_move(move_list, encode_move(source_square, destination_square, piece, R, capture, 0, 0, 0));
+    add_move(move_list, encode_move(source_square, destination_square, piece, B, capture, 0, 0, 0));
+    add_move(move_list, encode_move(source_square, destination_square, piece, N, capture, 0, 0, 0));
   }
-  printf("Bishop \n");
-  for (int pos1D = 0; pos1D < 64; pos1D++) {
-    printf("0x%llxULL,\n", magic_number(pos1D, bishop_occupancy_setbits[pos1D], 1));
+  else {
+    add_move(move_list, encode_move(source_square, destination_square, piece, q, capture, 0, 0, 0));
+    add_move(move_list, encode_move(source_square, destination_square, piece, r, capture, 0, 0, 0));
+    add_move(move_list, encode_move(source_square, destination_square, piece, b, capture, 0, 0, 0));
+    add_move(move_list, encode_move(source_square, destination_square, piece, n, capture, 0, 0, 0));
   }
 }
 
-void init_piece_occupancy_setbits() {
-  printf("rook\n");
-  for (int rank = 7; rank > -1; --rank) {
-    for (int file = 0; file < 8; ++file) {
-      int pos1D = 8*rank + file;
-      printf(" %d,", popcount(mask_rook_occupancy(pos1D)));
+// generate all pseudo legal moves for the side to move
+// (legality is checked by make_move)
+void move_generation(moves* move_list) {
+  int source_square, destination_square;
+
+  uint64_t temp_piece_bitboard, temp_piece_attack;
+
+  stat_timer_start();
+
+  move_list->count = 0;
+
+  // pawn direction and ranks depend on the side to move
+  const int pawn = (side == white) ? P : p;
+  const int pawn_push = (side == white) ? 8 : -8;
+  const uint64_t promotion_rank = (side == white) ? (rank_8 >> 8) : (rank_1 << 8);
+  const uint64_t double_push_rank = (side == white) ? (rank_1 << 8) : (rank_8 >> 8);
+
+  // pawns
+  temp_piece_bitboard = piece_bitboards[pawn];
+  while (temp_piece_bitboard) {
+    source_square = LSB_index(temp_piece_bitboard);
+    destination_square = source_square + pawn_push;
+
+    // quiet pawn moves
+    if (!get_bit(piece_color_mask[white_black], destination_square)) {
+      if (get_bit(promotion_rank, source_square)) {
+        add_promotions(move_list, pawn, source_square, destination_square, 0);
+      }
+      else {
+        // single push
+        add_move(move_list, encode_move(source_square, destination_square, pawn, 0, 0, 0, 0, 0));
+
+        // double push
+        if (get_bit(double_push_rank, source_square) && !get_bit(piece_color_mask[white_black], destination_square + pawn_push)) {
+          add_move(move_list, encode_move(source_square, destination_square + pawn_push, pawn, 0, 0, 1, 0, 0));
+        }
+      }
     }
-    printf("\n");
+
+    // pawn captures
+    temp_piece_attack = pawn_attacks[side][source_square] & piece_color_mask[side ^ 1];
+    while (temp_piece_attack) {
+      destination_square = LSB_index(temp_piece_attack);
+
+      if (get_bit(promotion_rank, source_square)) {
+        add_promotions(move_list, pawn, source_square, destination_square, 1);
+      }
+      else {
+        add_move(move_list, encode_move(source_square, destination_square, pawn, 0, 1, 0, 0, 0));
+      }
+
+      reset_bit(&temp_piece_attack, destination_square);
+    }
+
+    // enpassant capture
+    if (enpassant_pos1D != out_of_bounds_pos1D && (pawn_attacks[side][source_square] & (1ULL << enpassant_pos1D))) {
+      add_move(move_list, encode_move(source_square, enpassant_pos1D, pawn, 0, 1, 0, 1, 0));
+    }
+
+    reset_bit(&temp_piece_bitboard, source_square);
   }
 
-  printf("bishop");
-  for (int rank = 7; rank > -1; --rank) {
-    for (int file = 0; file < 8; ++file) {
-      int pos1D = 8*rank + file;
-      printf(" %d,", popcount(mask_bishop_occupancy(pos1D)));
+  // castling
+  if (side == white) {
+    // king side
+    if ((castle & wck) && !get_bit(piece_color_mask[white_black], f1) && !get_bit(piece_color_mask[white_black], g1)) {
+      if (!is_square_attacked(e1, black) && !is_square_attacked(f1, black)) {
+        add_move(move_list, encode_move(e1, g1, K, 0, 0, 0, 0, 1));
+      }
+    }
+    // queen side
+    if ((castle & wcq) && !get_bit(piece_color_mask[white_black], d1) && !get_bit(piece_color_mask[white_black], c1) && !get_bit(piece_color_mask[white_black], b1)) {
+      if (!is_square_attacked(e1, black) && !is_square_attacked(d1, black)) {
+        add_move(move_list, encode_move(e1, c1, K, 0, 0, 0, 0, 1));
+      }
+    }
+  }
+  else {
+    // king side
+    if ((castle & bck) && !get_bit(piece_color_mask[white_black], f8) && !get_bit(piece_color_mask[white_black], g8)) {
+      if (!is_square_attacked(e8, white) && !is_square_attacked(f8, white)) {
+        add_move(move_list, encode_move(e8, g8, k, 0, 0, 0, 0, 1));
+      }
+    }
+    // queen side
+    if ((castle & bcq) && !get_bit(piece_color_mask[white_black], d8) && !get_bit(piece_color_mask[white_black], c8) && !get_bit(piece_color_mask[white_black], b8)) {
+      if (!is_square_attacked(e8, white) && !is_square_attacked(d8, white)) {
+        add_move(move_list, encode_move(e8, c8, k, 0, 0, 0, 0, 1));
+      }
     }
-    printf("\n");
   }
 
-}
+  // knights, bishops, rooks, queens and king
+  for (int piece = (side == white) ? N : n; piece <= ((side == white) ? K : k); ++piece) {
+    temp_piece_bitboard = piece_bitboards[piece];
 
-void init_leapers() {
-  for (int square = 0; square < 64; square++) {
-    // init pawn attacks
-    pawn_attacks[white][square] = mask_pawn_attacks(white, square);
-    pawn_attacks[black][square] = mask_pawn_attacks(black, square);
-    
-    // init knight attacks
-    knight_attacks[square] = mask_knight_attacks(square);
-    
-    // init king attacks
-    king_attacks[square] = mask_king_attacks(square);
+    while (temp_piece_bitboard) {
+      source_square = LSB_index(temp_piece_bitboard);
+
+      switch (piece) {
+        case N: case n: temp_piece_attack = knight_attacks[source_square]; break;
+        case B: case b: temp_piece_attack = get_bishop_attacks(source_square, piece_color_mask[white_black]); break;
+        case R: case r: temp_piece_attack = get_rook_attacks(source_square, piece_color_mask[white_black]); break;
+        case Q: case q: temp_piece_attack = get_queen_attacks(source_square, piece_color_mask[white_black]); break;
+        default: temp_piece_attack = king_attacks[source_square]; break;
+      }
+
+      add_piece_moves(move_list, piece, source_square, temp_piece_attack);
+
+      reset_bit(&temp_piece_bitboard, source_square);
+    }
   }
+
+  stat_add(generations, 1);
+  stat_add(generated_moves, move_list->count);
+  stat_timer_stop(generate_cycles);
 }
 
-void init_sliders() {
-  for (int pos1D = 0; pos1D <64; ++pos1D) {
-    int set_bits;
-    int possible_combinations;
-    int hash_index;
-    // bishop
-    // occupancy mask
-    bishop_masks[pos1D] = mask_bishop_occupancy(pos1D);
-    set_bits = bishop_occupancy_setbits[pos1D];
-    possible_combinations = (1 << set_bits);
+// parse FEN (or the position fields of an EPD line) in [fen, end) with validation,
+// returns a pointer past the parsed fields, or NULL with *error set if the position is invalid
+// (including the side not to move being in check, so every accepted position is safe to search)
+const char* parse_FEN_checked(const char* fen, const char* end, const char** error) {
+  memset(piece_bitboards, 0ULL, sizeof(piece_bitboards));
+  memset(piece_color_mask, 0ULL, sizeof(piece_color_mask));
+  side = white;
+  enpassant_pos1D = out_of_bounds_pos1D;
+  castle = 0;
 
-    // iterating through all possible occupancies 
-    for (int ith = 0; ith < possible_combinations; ++ith) {
-      uint64_t ith_occupancy = ith_occupancy_combination(ith, set_bits, bishop_masks[pos1D]);
+  while (fen < end && *fen == ' ') ++fen;
 
-      // hashed index
-      hash_index = (ith_occupancy * bishop_magic_numbers[pos1D]) >> (64 - set_bits);
+  // piece placement
+  int rank = 7, file = 0;
+  for (; fen < end && *fen != ' '; ++fen) {
+    char c = *fen;
 
-      // set bishop attacks
-      bishop_attacks[pos1D][hash_index] = mask_bishop_attacks_given_occupancy(pos1D, ith_occupancy);
-      
+    if (c == '/') {
+      if (file != 8 || rank == 0) {
+        *error = "bad piece placement";
+        return NULL;
+      }
+      --rank;
+      file = 0;
     }
-    // rook
-    // occupancy mask
-    rook_masks[pos1D] = mask_rook_occupancy(pos1D);
-    set_bits = rook_occupancy_setbits[pos1D];
-    possible_combinations = (1 << set_bits);
-
-    // iterating through all possible occupancies 
-    for (int ith = 0; ith < possible_combinations; ++ith) {
-      uint64_t ith_occupancy = ith_occupancy_combination(ith, set_bits, rook_masks[pos1D]);
+    else if (c >= '1' && c <= '8') {
+      file += c - '0';
+      if (file > 8) {
+        *error = "bad piece placement";
+        return NULL;
+      }
+    }
+    else if (c != '\0' && strchr("PNBRQKpnbrqk", c)) {
+      if (file > 7) {
+        *error = "bad piece placement";
+        return NULL;
+      }
+      set_bit(&piece_bitboards[ascii_piece_refer_value[(unsigned char)c]], rank * 8 + file);
+      ++file;
+    }
+    else {
+      *error = "invalid character in piece placement";
+      return NULL;
+    }
+  }
 
-      // hashed index
-      hash_index = (ith_occupancy * rook_magic_numbers[pos1D]) >> (64 - set_bits);
+  if (rank != 0 || file != 8) {
+    *error = "bad piece placement";
+    return NULL;
+  }
 
-      // set rook attacks
-      rook_attacks[pos1D][hash_index] = mask_rook_attacks_given_occupancy(pos1D, ith_occupancy);
-      
+  // side to move
+  while (fen < end && *fen == ' ') ++fen;
+  if (fen >= end || (*fen != 'w' && *fen != 'b')) {
+    *error = "missing or invalid side to move";
+    return NULL;
+  }
+  side = (*fen == 'w') ? white : black;
+  ++fen;
 
+  // castle rights
+  while (fen < end && *fen == ' ') ++fen;
+  if (fen >= end) {
+    *error = "missing castling rights";
+    return NULL;
+  }
+  if (*fen == '-') {
+    ++fen;
+  }
+  else {
+    for (; fen < end && *fen != ' '; ++fen) {
+      switch (*fen) {
+        case 'K': castle |= wck; break;
+        case 'Q': castle |= wcq; break;
+        case 'k': castle |= bck; break;
+        case 'q': castle |= bcq; break;
+        default:
+          *error = "invalid castling rights";
+          return NULL;
+      }
     }
   }
-}
-
-void init() {
-  init_leapers();
-  // init_piece_occupancy_setbits(); -> stored in array already
-  // init_magic_numbers(); -> stored in array already
-  init_sliders();
-}
 
-// =====================
-// Main
-// =====================
+  // en passant
+  while (fen < end && *fen == ' ') ++fen;
+  if (fen >= end) {
+    *error = "missing en passant square";
+    return NULL;
+  }
+  if (*fen == '-') {
+    ++fen;
+  }
+  else {
+    if (fen + 1 >= end || fen[0] < 'a' || fen[0] > 'h' || fen[1] != ((side == white) ? '6' : '3')) {
+      *error = "invalid en passant square";
+      return NULL;
+    }
+    enpassant_pos1D = (fen[1] - '1') * 8 + (fen[0] - 'a');
+    fen += 2;
+  }
 
-int main() {
-  init();
-  
-  
-  parse_FEN(tricky_position);
-  //parse_FEN(start_position);
-  print_board();
-  print_bitboard(piece_color_mask[white_black]);
+  // optional half move and full move numbers
+  halfmove_clock = 0;
+  for (int field = 0; field < 2; ++field) {
+    const char* number = fen;
+    while (number < end && *number == ' ') ++number;
+    if (number >= end || *number < '0' || *number > '9') break;
+    if (field == 0) halfmove_clock = atoi(number);
+    while (number < end && *number >= '0' && *number <= '9') ++number;
+    fen = number;
+  }
+
+  for (int piece = P; piece <= K; ++piece) {
+    piece_color_mask[white] |= piece_bitboards[piece];
+  }
+  for (int piece = p; piece <= k; ++piece) {
+    piece_color_mask[black] |= piece_bitboards[piece];
+  }
+  piece_color_mask[white_black] = piece_color_mask[white] | piece_color_mask[black];
+
+  if (popcount(piece_bitboards[K]) != 1 || popcount(piece_bitboards[k]) != 1) {
+    *error = "each side needs exactly one king";
+    return NULL;
+  }
+
+  // ranks 1 and 8
+  if ((piece_bitboards[P] | piece_bitboards[p]) & 0xff000000000000ffULL) {
+    *error = "pawn on first or last rank";
+    return NULL;
+  }
+
+  if (((castle & wck) && !(get_bit(piece_bitboards[K], e1) && get_bit(piece_bitboards[R], h1))) ||
+      ((castle & wcq) && !(get_bit(piece_bitboards[K], e1) && get_bit(piece_bitboards[R], a1))) ||
+      ((castle & bck) && !(get_bit(piece_bitboards[k], e8) && get_bit(piece_bitboards[r], h8))) ||
+      ((castle & bcq) && !(get_bit(piece_bitboards[k], e8) && get_bit(piece_bitboards[r], a8)))) {
+    *error = "castling rights without king and rook in place";
+    return NULL;
+  }
+
+  // the king of the side that just moved could be captured
+  if (is_square_attacked(LSB_index(piece_bitboards[(side == white) ? k : K]), side)) {
+    *error = "side not to move is in check";
+    return NULL;
+  }
+
+  hash_key = generate_hash_key();
+  key_history_count = 0;
+  plies_from_null = 0;
+
+  return fen;
+}
+
+// =====================
+// Make Move
+// =====================
+
+// preserve board state
+#define copy_board() \
+  uint64_t piece_bitboards_copy[12], piece_color_mask_copy[3]; \
+  int side_copy, enpassant_pos1D_copy, castle_copy; \
+  int halfmove_clock_copy, plies_from_null_copy, key_history_count_copy; \
+  uint64_t hash_key_copy; \
+  memcpy(piece_bitboards_copy, piece_bitboards, sizeof(piece_bitboards)); \
+  memcpy(piece_color_mask_copy, piece_color_mask, sizeof(piece_color_mask)); \
+  side_copy = side, enpassant_pos1D_copy = enpassant_pos1D, castle_copy = castle; \
+  halfmove_clock_copy = halfmove_clock, plies_from_null_copy = plies_from_null, key_history_count_copy = key_history_count; \
+  hash_key_copy = hash_key;
+
+// restore board state
+#define take_back() \
+  memcpy(piece_bitboards, piece_bitboards_copy, sizeof(piece_bitboards)); \
+  memcpy(piece_color_mask, piece_color_mask_copy, sizeof(piece_color_mask)); \
+  side = side_copy, enpassant_pos1D = enpassant_pos1D_copy, castle = castle_copy; \
+  halfmove_clock = halfmove_clock_copy, plies_from_null = plies_from_null_copy, key_history_count = key_history_count_copy; \
+  hash_key = hash_key_copy;
+
+// board state that can be handed between threads
+typedef struct {
+  uint64_t piece_bitboards[12];
+  uint64_t piece_color_mask[3];
+  int side;
+  int enpassant_pos1D;
+  int castle;
+  uint64_t hash_key;
+  int halfmove_clock;
+  int plies_from_null;
+  int key_history_count;
+  uint64_t key_history[key_history_size];
+} position;
+
+// store current board state in pos
+void save_position(position* pos) {
+  memcpy(pos->piece_bitboards, piece_bitboards, sizeof(piece_bitboards));
+  memcpy(pos->piece_color_mask, piece_color_mask, sizeof(piece_color_mask));
+  pos->side = side;
+  pos->enpassant_pos1D = enpassant_pos1D;
+  pos->castle = castle;
+  pos->hash_key = hash_key;
+  pos->halfmove_clock = halfmove_clock;
+  pos->plies_from_null = plies_from_null;
+  pos->key_history_count = key_history_count;
+  memcpy(pos->key_history, key_history, sizeof(key_history));
+}
+
+// set current board state from pos
+void load_position(const position* pos) {
+  memcpy(piece_bitboards, pos->piece_bitboards, sizeof(piece_bitboards));
+  memcpy(piece_color_mask, pos->piece_color_mask, sizeof(piece_color_mask));
+  side = pos->side;
+  enpassant_pos1D = pos->enpassant_pos1D;
+  castle = pos->castle;
+  hash_key = pos->hash_key;
+  halfmove_clock = pos->halfmove_clock;
+  plies_from_null = pos->plies_from_null;
+  key_history_count = pos->key_history_count;
+  memcpy(key_history, pos->key_history, sizeof(key_history));
+}
+
+// move types for make_move
+enum { all_moves, only_captures };
+
+/*
+  castling rights are updated with castle &= castling_rights[square] for both
+  the source and the destination square of every move
+
+                            castle   binary   decimal
+
+  king & rooks didn't move:  1111  &  1111  =  15
+         white king moved:   1111  &  1100  =  12
+   white king's rook moved:  1111  &  1110  =  14
+  white queen's rook moved:  1111  &  1101  =  13
+         black king moved:   1111  &  0011  =  3
+   black king's rook moved:  1111  &  1011  =  11
+  black queen's rook moved:  1111  &  0111  =  7
+*/
+const int castling_rights[64] = {
+  13, 15, 15, 15, 12, 15, 15, 14,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+   7, 15, 15, 15,  3, 15, 15, 11
+};
+
+// make move on board, returns 0 (and leaves the board untouched) if the move is illegal
+static inline int make_move(const int move, const int move_flag) {
+  // quiet moves
+  if (move_flag == all_moves) {
+    stat_add(makes, 1);
+    stat_timer_start();
+
+    // preserve board state
+    copy_board();
+
+    // parse move
+    int source_square = get_move_source(move);
+    int destination_square = get_move_destination(move);
+    int piece = get_move_piece(move);
+    int promoted_piece = get_move_promoted(move);
+    int capture = get_move_capture(move);
+    int double_push = get_move_double_push(move);
+    int enpassant = get_move_enpassant(move);
+    int castling = get_move_castling(move);
+
+    push_key_history();
+    ++plies_from_null;
+    halfmove_clock = (capture || piece == P || piece == p) ? 0 : halfmove_clock + 1;
+
+    // move piece
+    reset_bit(&piece_bitboards[piece], source_square);
+    set_bit(&piece_bitboards[piece], destination_square);
+    hash_key ^= piece_keys[piece][source_square];
+    hash_key ^= piece_keys[piece][destination_square];
+
+    // remove captured piece
+    if (capture && !enpassant) {
+      int start_piece = (side == white) ? p : P;
+      int end_piece = (side == white) ? k : K;
+
+      for (int bb_piece = start_piece; bb_piece <= end_piece; ++bb_piece) {
+        if (get_bit(piece_bitboards[bb_piece], destination_square)) {
+          reset_bit(&piece_bitboards[bb_piece], destination_square);
+          hash_key ^= piece_keys[bb_piece][destination_square];
+          break;
+        }
+      }
+    }
+
+    // pawn promotion
+    if (promoted_piece) {
+      reset_bit(&piece_bitboards[piece], destination_square);
+      set_bit(&piece_bitboards[promoted_piece], destination_square);
+      hash_key ^= piece_keys[piece][destination_square];
+      hash_key ^= piece_keys[promoted_piece][destination_square];
+    }
+
+    // enpassant capture removes the pawn behind the destination square
+    if (enpassant) {
+      if (side == white) {
+        reset_bit(&piece_bitboards[p], destination_square - 8);
+        hash_key ^= piece_keys[p][destination_square - 8];
+      }
+      else {
+        reset_bit(&piece_bitboards[P], destination_square + 8);
+        hash_key ^= piece_keys[P][destination_square + 8];
+      }
+    }
+
+    // reset enpassant square
+    if (enpassant_pos1D != out_of_bounds_pos1D) hash_key ^= enpassant_keys[enpassant_pos1D];
+    enpassant_pos1D = out_of_bounds_pos1D;
+
+    // double pawn push sets enpassant square
+    if (double_push) {
+      enpassant_pos1D = (side == white) ? destination_square - 8 : destination_square + 8;
+      hash_key ^= enpassant_keys[enpassant_pos1D];
+    }
+
+    // move rook when castling
+    if (castling) {
+      int rook = (side == white) ? R : r;
+      int rook_source, rook_destination;
+
+      switch (destination_square) {
+        case g1: rook_source = h1; rook_destination = f1; break;
+        case c1: rook_source = a1; rook_destination = d1; break;
+        case g8: rook_source = h8; rook_destination = f8; break;
+        default: rook_source = a8; rook_destination = d8; break;
+      }
+
+      reset_bit(&piece_bitboards[rook], rook_source);
+      set_bit(&piece_bitboards[rook], rook_destination);
+      hash_key ^= piece_keys[rook][rook_source];
+      hash_key ^= piece_keys[rook][rook_destination];
+    }
+
+    // update castling rights
+    hash_key ^= castle_keys[castle];
+    castle &= castling_rights[source_square];
+    castle &= castling_rights[destination_square];
+    hash_key ^= castle_keys[castle];
+
+    // update occupancy masks
+    piece_color_mask[white] = piece_bitboards[P] | piece_bitboards[N] | piece_bitboards[B] | piece_bitboards[R] | piece_bitboards[Q] | piece_bitboards[K];
+    piece_color_mask[black] = piece_bitboards[p] | piece_bitboards[n] | piece_bitboards[b] | piece_bitboards[r] | piece_bitboards[q] | piece_bitboards[k];
+    piece_color_mask[white_black] = piece_color_mask[white] | piece_color_mask[black];
+
+    // change side
+    side ^= 1;
+    hash_key ^= side_key;
+
+    // king of the side that just moved must not be left in check
+    if (is_square_attacked(LSB_index(piece_bitboards[(side == white) ? k : K]), side)) {
+      take_back();
+      stat_timer_stop(make_cycles);
+      return 0;
+    }
+
+    stat_timer_stop(make_cycles);
+    return 1;
+  }
+
+  // captures only
+  else {
+    if (get_move_capture(move)) {
+      return make_move(move, all_moves);
+    }
+    return 0;
+  }
+}
+
+// is the side to move checkmated
+static int is_checkmate() {
+  if (!is_square_attacked(LSB_index(piece_bitboards[(side == white) ? K : k]), side ^ 1)) return 0;
+
+  moves move_list[1];
+  move_generation(move_list);
+
+  for (int i = 0; i < move_list->count; ++i) {
+    copy_board();
+    if (make_move(move_list->moves[i], all_moves)) {
+      take_back();
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+// =====================
+// Repetitions
+// =====================
+
+// times the current position occurred before since the last irreversible move, counting stops at max_count
+static inline int count_repetitions(const int max_count) {
+  int end = (halfmove_clock < plies_from_null) ? halfmove_clock : plies_from_null;
+  int count = 0;
+
+  if (end > key_history_size - 1) end = key_history_size - 1;
+
+  // only positions with the same side to move, the nearest one is 4 plies back
+  for (int distance = 4; distance <= end; distance += 2) {
+    if (key_history_at(distance) == hash_key && ++count >= max_count) break;
+  }
+
+  return count;
+}
+
+// did the current position occur before since the last irreversible move
+static inline int is_repetition() {
+  return count_repetitions(1);
+}
+
+/*
+  cuckoo table of every reversible move of a knight, bishop, rook, queen or
+  king on an empty board, keyed by the hash key difference the move makes.
+  if the keys of the current position and a position an odd number of plies
+  back differ by one such move (and the opponent's moves in between cancel
+  out), the side to move can go back to that position if the squares
+  between are free. 3668 moves in 8192 slots, every key sits in one of its
+  two slots (Marcel van Kervinck's method)
+*/
+#define cuckoo_size 8192
+
+uint64_t cuckoo_keys[cuckoo_size];
+int cuckoo_moves[cuckoo_size];
+
+#define cuckoo_slot_1(key) ((int)((key) & (cuckoo_size - 1)))
+#define cuckoo_slot_2(key) ((int)(((key) >> 16) & (cuckoo_size - 1)))
+
+// squares strictly between two squares on a line, 0 if they don't share one
+static inline uint64_t squares_between(const int source, const int destination) {
+  if (get_bishop_attacks(source, 0ULL) & (1ULL << destination)) {
+    return get_bishop_attacks(source, 1ULL << destination) & get_bishop_attacks(destination, 1ULL << source);
+  }
+  if (get_rook_attacks(source, 0ULL) & (1ULL << destination)) {
+    return get_rook_attacks(source, 1ULL << destination) & get_rook_attacks(destination, 1ULL << source);
+  }
+  return 0ULL;
+}
+
+void init_cuckoo() {
+  memset(cuckoo_keys, 0, sizeof(cuckoo_keys));
+  memset(cuckoo_moves, 0, sizeof(cuckoo_moves));
+
+  for (int piece = P; piece <= k; ++piece) {
+    if (piece == P || piece == p) continue;
+
+    for (int source = 0; source < 64; ++source) {
+      uint64_t attacks;
+
+      switch (piece) {
+        case N: case n: attacks = knight_attacks[source]; break;
+        case B: case b: attacks = get_bishop_attacks(source, 0ULL); break;
+        case R: case r: attacks = get_rook_attacks(source, 0ULL); break;
+        case Q: case q: attacks = get_queen_attacks(source, 0ULL); break;
+        default: attacks = king_attacks[source]; break;
+      }
+
+      // each move once, the reverse move has the same key
+      for (int destination = source + 1; destination < 64; ++destination) {
+        if (!get_bit(attacks, destination)) continue;
+
+        uint64_t key = piece_keys[piece][source] ^ piece_keys[piece][destination] ^ side_key;
+        int move = source | (destination << 6);
+        int slot = cuckoo_slot_1(key);
+
+        // insert, kicking the occupant to its other slot until an empty one is hit
+        while (1) {
+          uint64_t kicked_key = cuckoo_keys[slot];
+          int kicked_move = cuckoo_moves[slot];
+
+          cuckoo_keys[slot] = key;
+          cuckoo_moves[slot] = move;
+
+          if (kicked_move == 0) break;
+
+          key = kicked_key;
+          move = kicked_move;
+          slot = (slot == cuckoo_slot_1(key)) ? cuckoo_slot_2(key) : cuckoo_slot_1(key);
+        }
+      }
+    }
+  }
+}
+
+// can the side to move repeat a position of the search path (search_ply plies deep) with its next move
+static inline int has_upcoming_repetition(const int search_ply) {
+  int end = (halfmove_clock < plies_from_null) ? halfmove_clock : plies_from_null;
+
+  if (end < 3) return 0;
+
+  // opponent moves since the position distance plies back, zero when they cancel out
+  uint64_t other_moves = hash_key ^ key_history_at(1) ^ side_key;
+
+  for (int distance = 3; distance <= end && distance < search_ply; distance += 2) {
+    other_moves ^= key_history_at(distance - 1) ^ key_history_at(distance) ^ side_key;
+
+    if (other_moves) continue;
+
+    uint64_t move_key = hash_key ^ key_history_at(distance);
+    int slot = cuckoo_slot_1(move_key);
+
+    if (cuckoo_keys[slot] != move_key) {
+      slot = cuckoo_slot_2(move_key);
+      if (cuckoo_keys[slot] != move_key) continue;
+    }
+
+    int source = cuckoo_moves[slot] & 0x3f;
+    int destination = cuckoo_moves[slot] >> 6;
+
+    if (!(squares_between(source, destination) & piece_color_mask[white_black])) return 1;
+  }
+
+  return 0;
+}
+
+// =====================
+// Perft
+// =====================
+
+// leaf nodes
+uint64_t perft_nodes;
+
+// get time in milliseconds from a monotonic clock
+static inline uint64_t get_time_ms() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000ULL + (uint64_t)now.tv_nsec / 1000000ULL;
+}
+
+void perft_driver(const int depth) {
+  if (depth == 0) {
+    ++perft_nodes;
+    return;
+  }
+
+  moves move_list[1];
+  move_generation(move_list);
+
+  for (int i = 0; i < move_list->count; ++i) {
+    copy_board();
+
+    if (!make_move(move_list->moves[i], all_moves)) continue;
+
+    perft_driver(depth - 1);
+
+    take_back();
+  }
+}
+
+// perft with node count per root move
+void perft_test(const int depth) {
+  printf("\n    Performance test\n\n");
+
+  moves move_list[1];
+  move_generation(move_list);
+
+  perft_nodes = 0;
+  uint64_t start = get_time_ms();
+
+  for (int i = 0; i < move_list->count; ++i) {
+    copy_board();
+
+    if (!make_move(move_list->moves[i], all_moves)) continue;
+
+    uint64_t cumulative_nodes = perft_nodes;
+    perft_driver(depth - 1);
+
+    take_back();
+
+    printf("    ");
+    print_move(move_list->moves[i]);
+    printf(": %llu\n", (unsigned long long)(perft_nodes - cumulative_nodes));
+  }
+
+  printf("\n    Depth: %d", depth);
+  printf("\n    Nodes: %llu", (unsigned long long)perft_nodes);
+  printf("\n    Time : %llu ms\n\n", (unsigned long long)(get_time_ms() - start));
+}
+
+// =====================
+// Evaluation
+// =====================
+
+// material score [piece]
+const int material_score[12] = {
+  100, 300, 350, 500, 1000, 10000,
+  -100, -300, -350, -500, -1000, -10000
+};
+
+// pawn positional score (from white's point of view, a8 first)
+const int pawn_score[64] = {
+   90,  90,  90,  90,  90,  90,  90,  90,
+   30,  30,  30,  40,  40,  30,  30,  30,
+   20,  20,  20,  30,  30,  30,  20,  20,
+   10,  10,  10,  20,  20,  10,  10,  10,
+    5,   5,  10,  20,  20,   5,   5,   5,
+    0,   0,   0,   5,   5,   0,   0,   0,
+    0,   0,   0, -10, -10,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0
+};
+
+// knight positional score
+const int knight_score[64] = {
+   -5,   0,   0,   0,   0,   0,   0,  -5,
+   -5,   0,   0,  10,  10,   0,   0,  -5,
+   -5,   5,  20,  20,  20,  20,   5,  -5,
+   -5,  10,  20,  30,  30,  20,  10,  -5,
+   -5,  10,  20,  30,  30,  20,  10,  -5,
+   -5,   5,  20,  10,  10,  20,   5,  -5,
+   -5,   0,   0,   0,   0,   0,   0,  -5,
+   -5, -10,   0,   0,   0,   0, -10,  -5
+};
+
+// bishop positional score
+const int bishop_score[64] = {
+    0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,  10,  10,   0,   0,   0,
+    0,   0,  10,  20,  20,  10,   0,   0,
+    0,   0,  10,  20,  20,  10,   0,   0,
+    0,  10,   0,   0,   0,   0,  10,   0,
+    0,  30,   0,   0,   0,   0,  30,   0,
+    0,   0, -10,   0,   0, -10,   0,   0
+};
+
+// rook positional score
+const int rook_score[64] = {
+   50,  50,  50,  50,  50,  50,  50,  50,
+   50,  50,  50,  50,  50,  50,  50,  50,
+    0,   0,  10,  20,  20,  10,   0,   0,
+    0,   0,  10,  20,  20,  10,   0,   0,
+    0,   0,  10,  20,  20,  10,   0,   0,
+    0,   0,  10,  20,  20,  10,   0,   0,
+    0,   0,  10,  20,  20,  10,   0,   0,
+    0,   0,   0,  20,  20,   0,   0,   0
+};
+
+// king positional score while there is material to attack it
+const int king_score[64] = {
+    0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   5,   5,   5,   5,   0,   0,
+    0,   5,   5,  10,  10,   5,   5,   0,
+    0,   5,  10,  20,  20,  10,   5,   0,
+    0,   5,  10,  20,  20,  10,   5,   0,
+    0,   0,   5,  10,  10,   5,   0,   0,
+    0,   5,   5,  -5,  -5,   0,   5,   0,
+    0,   0,   5,   0, -15,   0,  10,   0
+};
+
+// king positional score in the endgame, the king belongs in the center
+const int king_endgame_score[64] = {
+  -50, -30, -30, -30, -30, -30, -30, -50,
+  -30, -20, -10,   0,   0, -10, -20, -30,
+  -30, -10,  20,  30,  30,  20, -10, -30,
+  -30, -10,  30,  40,  40,  30, -10, -30,
+  -30, -10,  30,  40,  40,  30, -10, -30,
+  -30, -10,  20,  30,  30,  20, -10, -30,
+  -30, -30,   0,   0,   0,   0, -30, -30,
+  -50, -30, -30, -30, -30, -30, -30, -50
+};
+
+// the tables above are laid out as printed (a8 first), white pieces index them with pos1D ^ 56
+// and black pieces with pos1D directly which mirrors the board vertically
+#define flip_pos1D(pos1D) ((pos1D) ^ 56)
+
+// positional score of a piece from its own side's point of view (kings see king_positional_score)
+static inline int positional_score(const int piece_type, const int pos1D) {
+  switch (piece_type) {
+    case P: return pawn_score[pos1D];
+    case N: return knight_score[pos1D];
+    case B: return bishop_score[pos1D];
+    case R: return rook_score[pos1D];
+    default: return 0;
+  }
+}
+
+// game phase, 24 with all pieces on the board down to 0 with only pawns left
+#define max_phase 24
+
+// king positional score tapered between the middlegame and the endgame table
+static inline int king_positional_score(const int pos1D, const int phase) {
+  return (king_score[pos1D] * phase + king_endgame_score[pos1D] * (max_phase - phase)) / max_phase;
+}
+
+// material key from piece counts, 4 bits per piece type
+static inline uint64_t material_key() {
+  uint64_t key = 0ULL;
+
+  for (int piece = P; piece <= k; ++piece) {
+    key |= (uint64_t)popcount(piece_bitboards[piece]) << (4 * piece);
+  }
+
+  return key;
+}
+
+// king steps between two squares
+static inline int square_distance(const int pos1D_a, const int pos1D_b) {
+  int rank_distance = abs((pos1D_a >> 3) - (pos1D_b >> 3));
+  int file_distance = abs((pos1D_a & 7) - (pos1D_b & 7));
+  return (rank_distance > file_distance) ? rank_distance : file_distance;
+}
+
+/*
+  kpk bitbase: every king + pawn vs king position with the pawn on files
+  a - d (the rest is mirrored) and the pawn's side as white, one bit that
+  says whether it's a win. it is solved at startup by retrograde iteration:
+  positions start as invalid, won (safe promotion), drawn (the lone king
+  is stalemated or takes the pawn) or unknown, and unknown positions are
+  resolved from their successors until nothing changes
+
+  index bits
+
+  strong king    0 .. 5
+  weak king      6 .. 11
+  side to move  12
+  pawn file     13 .. 14
+  6 - pawn rank 15 .. 17
+*/
+
+#define kpk_positions (2 * 24 * 64 * 64)
+
+enum { kpk_invalid = 0, kpk_unknown = 1, kpk_draw = 2, kpk_win = 4 };
+
+uint32_t kpk_bitbase[kpk_positions / 32];
+
+static inline int kpk_index(const int side_to_move, const int strong_king, const int weak_king, const int pawn) {
+  return strong_king | (weak_king << 6) | (side_to_move << 12) | ((pawn & 7) << 13) | ((6 - (pawn >> 3)) << 15);
+}
+
+// result of a position from the results of the positions after each move
+static int kpk_classify(const uint8_t* results, const int index) {
+  int strong_king = index & 63;
+  int weak_king = (index >> 6) & 63;
+  int side_to_move = (index >> 12) & 1;
+  int pawn = ((index >> 13) & 3) + (6 - ((index >> 15) & 7)) * 8;
+
+  // white wants a win, black is happy with a draw
+  int good = (side_to_move == white) ? kpk_win : kpk_draw;
+  int bad = (side_to_move == white) ? kpk_draw : kpk_win;
+
+  int result = kpk_invalid;
+  uint64_t king_moves = king_attacks[(side_to_move == white) ? strong_king : weak_king];
+
+  while (king_moves) {
+    int pos1D = LSB_index(king_moves);
+
+    result |= (side_to_move == white) ? results[kpk_index(black, pos1D, weak_king, pawn)] : results[kpk_index(white, strong_king, pos1D, pawn)];
+
+    king_moves &= king_moves - 1;
+  }
+
+  // pawn pushes, promotions are only counted by the initial classification
+  if (side_to_move == white) {
+    if ((pawn >> 3) < 6) result |= results[kpk_index(black, strong_king, weak_king, pawn + 8)];
+
+    if ((pawn >> 3) == 1 && pawn + 8 != strong_king && pawn + 8 != weak_king) {
+      result |= results[kpk_index(black, strong_king, weak_king, pawn + 16)];
+    }
+  }
+
+  if (result & good) return good;
+  if (result & kpk_unknown) return kpk_unknown;
+  return bad;
+}
+
+void init_kpk_bitbase() {
+  uint8_t* results = (uint8_t*)malloc(kpk_positions);
+
+  for (int index = 0; index < kpk_positions; ++index) {
+    int strong_king = index & 63;
+    int weak_king = (index >> 6) & 63;
+    int side_to_move = (index >> 12) & 1;
+    int pawn = ((index >> 13) & 3) + (6 - ((index >> 15) & 7)) * 8;
+
+    if (square_distance(strong_king, weak_king) <= 1 || strong_king == pawn || weak_king == pawn ||
+        (side_to_move == white && (pawn_attacks[white][pawn] & (1ULL << weak_king)))) {
+      results[index] = kpk_invalid;
+    }
+    // pawn promotes and the queen can't be taken
+    else if (side_to_move == white && (pawn >> 3) == 6 && strong_king != pawn + 8 && weak_king != pawn + 8 &&
+             (square_distance(weak_king, pawn + 8) > 1 || square_distance(strong_king, pawn + 8) == 1)) {
+      results[index] = kpk_win;
+    }
+    // lone king is stalemated or takes an undefended pawn
+    else if (side_to_move == black &&
+             (!(king_attacks[weak_king] & ~(king_attacks[strong_king] | pawn_attacks[white][pawn])) ||
+              (king_attacks[weak_king] & ~king_attacks[strong_king] & (1ULL << pawn)))) {
+      results[index] = kpk_draw;
+    }
+    else {
+      results[index] = kpk_unknown;
+    }
+  }
+
+  for (int changed = 1; changed; ) {
+    changed = 0;
+
+    for (int index = 0; index < kpk_positions; ++index) {
+      if (results[index] != kpk_unknown) continue;
+
+      results[index] = kpk_classify(results, index);
+      changed |= results[index] != kpk_unknown;
+    }
+  }
+
+  memset(kpk_bitbase, 0, sizeof(kpk_bitbase));
+
+  for (int index = 0; index < kpk_positions; ++index) {
+    if (results[index] == kpk_win) kpk_bitbase[index >> 5] |= 1U << (index & 31);
+  }
+
+  free(results);
+}
+
+/*
+  specialized endgames, chosen by the material entry. an evaluation function
+  returns the score from the strong side's point of view, a scale function
+  returns the factor (0 .. 64) the score of the side that is ahead is scaled by
+*/
+typedef int (*endgame_function)(const int strong_side);
+
+// bonus on top of the material for a won known endgame
+#define known_win_bonus 200
+
+// king + pawn vs king, won or drawn from the bitbase
+static int evaluate_kpk(const int strong_side) {
+  int strong_king = LSB_index(piece_bitboards[(strong_side == white) ? K : k]);
+  int weak_king = LSB_index(piece_bitboards[(strong_side == white) ? k : K]);
+  int pawn = LSB_index(piece_bitboards[(strong_side == white) ? P : p]);
+  int side_to_move = side;
+
+  // bitbase has the pawn white and on files a - d
+  if (strong_side == black) {
+    strong_king = flip_pos1D(strong_king);
+    weak_king = flip_pos1D(weak_king);
+    pawn = flip_pos1D(pawn);
+    side_to_move ^= 1;
+  }
+
+  if ((pawn & 7) >= 4) {
+    strong_king ^= 7;
+    weak_king ^= 7;
+    pawn ^= 7;
+  }
+
+  int index = kpk_index(side_to_move, strong_king, weak_king, pawn);
+
+  if (!(kpk_bitbase[index >> 5] & (1U << (index & 31)))) return 0;
+
+  return material_score[P] + known_win_bonus + 10 * (pawn >> 3);
+}
+
+// king + bishop + knight vs king, the lone king is driven to a corner of the bishop's color and the kings close in
+static int evaluate_kbnk(const int strong_side) {
+  int strong_king = LSB_index(piece_bitboards[(strong_side == white) ? K : k]);
+  int weak_king = LSB_index(piece_bitboards[(strong_side == white) ? k : K]);
+  int bishop = LSB_index(piece_bitboards[(strong_side == white) ? B : b]);
+
+  int king_distance = square_distance(strong_king, weak_king);
+
+  // a1 is dark, mate only works in a1 / h8 with a dark bishop, flip the files for a light one
+  if (((bishop >> 3) + (bishop & 7)) & 1) weak_king ^= 7;
+
+  // 7 in the right corners down to 0 on the long diagonal between the other two
+  int corner = abs(7 - (weak_king >> 3) - (weak_king & 7));
+
+  return material_score[B] + material_score[N] + 20 * corner + 10 * (7 - king_distance);
+}
+
+// king + rook vs king + pawn, won unless the pawn is far advanced with its king next to it
+static int evaluate_krkp(const int strong_side) {
+  int strong_king = LSB_index(piece_bitboards[(strong_side == white) ? K : k]);
+  int weak_king = LSB_index(piece_bitboards[(strong_side == white) ? k : K]);
+  int rook = LSB_index(piece_bitboards[(strong_side == white) ? R : r]);
+  int pawn = LSB_index(piece_bitboards[(strong_side == white) ? p : P]);
+
+  // rook side as white, the pawn runs down the board
+  if (strong_side == black) {
+    strong_king = flip_pos1D(strong_king);
+    weak_king = flip_pos1D(weak_king);
+    rook = flip_pos1D(rook);
+    pawn = flip_pos1D(pawn);
+  }
+
+  int strong_to_move = (side == strong_side);
+  int queening_square = pawn & 7;
+  int stop_square = pawn - 8;
+
+  // strong king in front of the pawn, or the lone king too far from both pawn and rook
+  if (((strong_king & 7) == (pawn & 7) && strong_king < pawn) ||
+      (square_distance(weak_king, pawn) >= 3 + !strong_to_move && square_distance(weak_king, rook) >= 3)) {
+    return material_score[R] - 10 * square_distance(strong_king, pawn);
+  }
+
+  // pawn far advanced and escorted, the strong king is too far away: likely draw
+  if ((weak_king >> 3) <= 2 && square_distance(weak_king, pawn) == 1 && (strong_king >> 3) >= 3 &&
+      square_distance(strong_king, pawn) > 2 + strong_to_move) {
+    return 40 - 4 * square_distance(strong_king, pawn);
+  }
+
+  return 100 - 4 * (square_distance(strong_king, stop_square) - square_distance(weak_king, stop_square) - square_distance(pawn, queening_square));
+}
+
+// opposite colored bishops with only pawns besides them are hard to win,
+// nearly a draw unless the strong side has more than one pawn to push
+static int scale_opposite_bishops(const int strong_side) {
+  const uint64_t dark_squares = 0xaa55aa55aa55aa55ULL;
+
+  if (!(piece_bitboards[B] & dark_squares) == !(piece_bitboards[b] & dark_squares)) return 64;
+
+  return (popcount(piece_bitboards[(strong_side == white) ? P : p]) > 1) ? 32 : 8;
+}
+
+/*
+  material hash: everything the evaluation takes from the piece counts alone
+  is computed once per material key and looked up by the other positions of
+  the same material. the table is per thread like the board, material keys
+  change so rarely along a search that a small table nearly always hits
+*/
+
+typedef struct {
+  uint64_t key;
+
+  // exact evaluation of a known endgame, NULL otherwise
+  endgame_function evaluate_endgame;
+
+  // scale factor that depends on more than the material, NULL otherwise
+  endgame_function scale_endgame;
+
+  // white's point of view
+  int16_t imbalance;
+
+  uint8_t phase;
+  uint8_t strong_side;
+
+  // scale factor when white / black is ahead, 64 = no scaling
+  uint8_t scale[2];
+} material_entry;
+
+#define material_table_size 4096
+
+_Thread_local material_entry material_table[material_table_size];
+
+#define bishop_pair_bonus 30
+
+// count[] holds exactly the given pieces besides the king
+static inline int has_only(const int* count, const int pawns, const int knights, const int bishops, const int rooks, const int queens) {
+  return count[P] == pawns && count[N] == knights && count[B] == bishops && count[R] == rooks && count[Q] == queens;
+}
+
+// imbalance of one side from its counts: bishop pair, knights gain and rooks lose value with more own pawns
+static inline int side_imbalance(const int* count) {
+  return ((count[B] >= 2) ? bishop_pair_bonus : 0) + (count[N] * 6 - count[R] * 12) * (count[P] - 5);
+}
+
+static void build_material_entry(material_entry* entry, const uint64_t key) {
+  int count[12];
+  for (int piece = P; piece <= k; ++piece) count[piece] = (key >> (4 * piece)) & 15;
+
+  entry->key = key;
+  entry->evaluate_endgame = NULL;
+  entry->scale_endgame = NULL;
+  entry->strong_side = white;
+
+  int phase = count[N] + count[n] + count[B] + count[b] + 2 * (count[R] + count[r]) + 4 * (count[Q] + count[q]);
+  entry->phase = (phase > max_phase) ? max_phase : phase;
+
+  entry->imbalance = side_imbalance(count) - side_imbalance(count + p);
+
+  // non pawn material of each side
+  int pieces_material[2];
+  for (int color = white; color <= black; ++color) {
+    const int* own = count + 6 * color;
+    pieces_material[color] = own[N] * material_score[N] + own[B] * material_score[B] + own[R] * material_score[R] + own[Q] * material_score[Q];
+  }
+
+  for (int color = white; color <= black; ++color) {
+    const int* own = count + 6 * color;
+    const int* other = count + 6 * (color ^ 1);
+
+    entry->scale[color] = 64;
+
+    // without pawns a side needs more than a minor piece up to win
+    if (own[P] == 0 && pieces_material[color] - pieces_material[color ^ 1] <= material_score[B]) {
+      entry->scale[color] = (pieces_material[color] < material_score[R]) ? 0 : (pieces_material[color ^ 1] <= material_score[B]) ? 4 : 14;
+    }
+
+    // two knights can't force mate
+    if (has_only(own, 0, 2, 0, 0, 0) && has_only(other, 0, 0, 0, 0, 0)) entry->scale[color] = 0;
+
+    // known endgames with color as the strong side
+    endgame_function endgame = NULL;
+
+    if (has_only(own, 1, 0, 0, 0, 0) && has_only(other, 0, 0, 0, 0, 0)) endgame = evaluate_kpk;
+    else if (has_only(own, 0, 1, 1, 0, 0) && has_only(other, 0, 0, 0, 0, 0)) endgame = evaluate_kbnk;
+    else if (has_only(own, 0, 0, 0, 1, 0) && has_only(other, 1, 0, 0, 0, 0)) endgame = evaluate_krkp;
+
+    if (endgame) {
+      entry->evaluate_endgame = endgame;
+      entry->strong_side = color;
+    }
+  }
+
+  if (count[B] == 1 && count[b] == 1 && count[N] + count[n] + count[R] + count[r] + count[Q] + count[q] == 0) {
+    entry->scale_endgame = scale_opposite_bishops;
+  }
+}
+
+// material entry of the given material key
+static inline material_entry* probe_material(const uint64_t key) {
+  material_entry* entry = &material_table[(key * 0x9e3779b97f4a7c15ULL) >> 52];
+
+  stat_add(material_probes, 1);
+
+  if (entry->key != key) build_material_entry(entry, key);
+  else stat_add(material_hits, 1);
+
+  return entry;
+}
+
+// scale a score from white's point of view down by the scale factor of the side that is ahead
+static inline int scale_score(const material_entry* entry, const int score) {
+  int ahead = (score > 0) ? white : black;
+  int scale = entry->scale[ahead];
+
+  if (entry->scale_endgame) {
+    int endgame_scale = entry->scale_endgame(ahead);
+    if (endgame_scale < scale) scale = endgame_scale;
+  }
+
+  return score * scale / 64;
+}
+
+// static evaluation relative to the side to move
+static inline int evaluate() {
+  stat_add(evaluations, 1);
+  stat_timer_start();
+
+  const material_entry* entry = probe_material(material_key());
+
+  if (entry->evaluate_endgame) {
+    int score = entry->evaluate_endgame(entry->strong_side);
+    stat_timer_stop(evaluate_cycles);
+    return (side == entry->strong_side) ? score : -score;
+  }
+
+  int score = entry->imbalance;
+
+  // kings are always there, their material cancels out
+  for (int piece = P; piece <= q; ++piece) {
+    if (piece == K) continue;
+
+    uint64_t bitboard = piece_bitboards[piece];
+
+    while (bitboard) {
+      int pos1D = LSB_index(bitboard);
+
+      score += material_score[piece];
+
+      if (piece <= K) {
+        score += positional_score(piece, flip_pos1D(pos1D));
+      }
+      else {
+        score -= positional_score(piece - p, pos1D);
+      }
+
+      reset_bit(&bitboard, pos1D);
+    }
+  }
+
+  score += king_positional_score(flip_pos1D(LSB_index(piece_bitboards[K])), entry->phase);
+  score -= king_positional_score(LSB_index(piece_bitboards[k]), entry->phase);
+
+  score = scale_score(entry, score);
+
+  stat_timer_stop(evaluate_cycles);
+
+  return (side == white) ? score : -score;
+}
+
+// =====================
+// Transposition Table
+// =====================
+
+#define no_hash_entry 100000
+
+// hash entry flags
+enum { hash_flag_exact, hash_flag_alpha, hash_flag_beta };
+
+/*
+  the table is shared by all search threads without locks, an entry stores
+  hash key ^ data so an entry torn by two threads writing at once fails the
+  key check instead of returning another position's data
+
+  data bits
+
+  best move   0 .. 23
+  flag       24 .. 25
+  depth      26 .. 33
+  score      34 .. 51 (offset by 2 * infinity to keep it positive)
+  generation 52 .. 57
+
+  the table is kept between moves, every search gets a new generation and
+  entries of older generations are replaced first
+*/
+
+// transposition table entry
+typedef struct {
+  uint64_t key;
+  uint64_t data;
+} tt;
+
+#define pack_hash_data(score, best_move, depth, flag) \
+  ((uint64_t)(best_move) | ((uint64_t)(flag) << 24) | ((uint64_t)((depth) & 0xff) << 26) | ((uint64_t)((score) + 2 * infinity) << 34) | \
+   ((uint64_t)current_hash_generation() << 52))
+
+#define get_hash_move(data) ((int)((data) & 0xffffff))
+#define get_hash_flag(data) ((int)(((data) >> 24) & 0x3))
+#define get_hash_depth(data) ((int)(((data) >> 26) & 0xff))
+#define get_hash_score(data) ((int)(((data) >> 34) & 0x3ffff) - 2 * infinity)
+#define get_hash_generation(data) ((int)(((data) >> 52) & 0x3f))
+
+// generation of the current search (6 bits)
+atomic_int hash_generation;
+
+// start a new generation, the entries of earlier searches become replaceable
+void new_hash_generation() {
+  int generation = atomic_load(&hash_generation);
+  atomic_store(&hash_generation, (generation + 1) & 0x3f);
+}
+
+// transposition table
+tt* hash_table = NULL;
+
+// number of entries in transposition table
+uint64_t hash_entries = 0;
+
+// clear transposition table
+void clear_hash_table() {
+  memset(hash_table, 0, hash_entries * sizeof(tt));
+}
+
+// (re)allocate transposition table with the given size in MB
+void init_hash_table(const int mb) {
+  free(hash_table);
+
+  hash_entries = ((uint64_t)mb * 0x100000) / sizeof(tt);
+  hash_table = (tt*)malloc(hash_entries * sizeof(tt));
+
+  if (hash_table == NULL) {
+    printf("    Couldn't allocate memory for hash table, trying %dMB...\n", mb / 2);
+    init_hash_table(mb / 2);
+    return;
+  }
+
+  clear_hash_table();
+}
+
+// private table of the calling thread (batch workers), NULL -> the shared table
+_Thread_local tt* own_hash_table = NULL;
+_Thread_local uint64_t own_hash_entries = 0;
+
+// table entry of the current position
+static inline tt* hash_table_entry() {
+  if (own_hash_table) return &own_hash_table[hash_key % own_hash_entries];
+  return &hash_table[hash_key % hash_entries];
+}
+
+// generation of new entries, a private table is cleared instead of aged
+static inline int current_hash_generation() {
+  return own_hash_table ? 0 : hash_generation;
+}
+
+// =====================
+// Time Management
+// =====================
+
+// search limits
+typedef struct {
+  int depth;
+  uint64_t nodes;
+  int movetime;
+  int wtime, btime, winc, binc, movestogo;
+  int infinite;
+  int ponder;
+
+  // go mate, look for a mate in that many moves with the proof number search first (0 -> off)
+  int mate;
+
+  // go searchmoves, only these root moves are searched (none -> all)
+  moves search_moves;
+} search_limits;
+
+search_limits limits;
+
+// search started at
+_Atomic uint64_t start_time;
+
+// hard limit, the search is stopped at this time wherever it is (0 -> no time limit)
+_Atomic uint64_t stop_time;
+
+// soft limit in ms after start_time, no new iteration is started past it (0 -> no time limit)
+_Atomic uint64_t soft_time_limit;
+
+// waiting for ponderhit, time limits are ignored meanwhile
+atomic_int pondering;
+
+// time kept back for gui and network lag (uci option Move Overhead)
+int move_overhead = 30;
+
+// the clock is read every time_check_interval nodes only (power of 2)
+#define time_check_interval 1024
+
+// soft limit scale by how many iterations in a row returned the same best move
+const double stability_scale[5] = { 1.50, 1.20, 1.00, 0.85, 0.70 };
+
+// main search thread's view of the previous iterations
+_Thread_local int best_move_stability;
+_Thread_local int previous_best_move;
+_Thread_local int previous_score;
+
+// set soft and hard limits of the search from the go limits
+void init_time_limits() {
+  int time = (side == white) ? limits.wtime : limits.btime;
+  int increment = (side == white) ? limits.winc : limits.binc;
+
+  stop_time = 0;
+  soft_time_limit = 0;
+
+  if (limits.infinite) return;
+
+  // fixed time per move, no point in stopping early
+  if (limits.movetime) {
+    int budget = limits.movetime - move_overhead;
+    if (budget < 1) budget = 1;
+
+    soft_time_limit = budget;
+    stop_time = start_time + budget;
+    return;
+  }
+
+  if (time <= 0) return;
+
+  int available = time - move_overhead;
+  if (available < 1) available = 1;
+
+  int movestogo = limits.movestogo ? limits.movestogo : 30;
+  if (movestogo > 50) movestogo = 50;
+
+  // soft limit is the average share of the clock, hard limit lets an unstable search overrun it
+  int soft = available / movestogo + increment * 3 / 4;
+  int hard = soft * 4;
+  int max_hard = (movestogo == 1) ? available : available / 2;
+
+  if (hard > max_hard) hard = max_hard;
+  if (soft > hard) soft = hard;
+  if (soft < 1) soft = 1;
+  if (hard < 1) hard = 1;
+
+  soft_time_limit = soft;
+  stop_time = start_time + hard;
+}
+
+// reset iteration history at the start of a search
+void reset_time_manager() {
+  best_move_stability = 0;
+  previous_best_move = 0;
+  previous_score = 0;
+}
+
+// after a completed iteration, is it worth starting another one
+int stop_iterating(const int best_move, const int score, const int depth) {
+  if (best_move == previous_best_move) {
+    ++best_move_stability;
+  }
+  else {
+    best_move_stability = 0;
+  }
+
+  int score_drop = previous_score - score;
+
+  previous_best_move = best_move;
+  previous_score = score;
+
+  if (soft_time_limit == 0 || atomic_load(&pondering)) return 0;
+
+  double scale = stability_scale[best_move_stability < 4 ? best_move_stability : 4];
+
+  // falling score, spend more time to find a way out (capped at twice the soft limit)
+  if (depth > 1 && score_drop > 20) {
+    double extension = 1.0 + score_drop / 100.0;
+    scale *= (extension < 2.0) ? extension : 2.0;
+  }
+
+  return get_time_ms() - start_time >= soft_time_limit * scale;
+}
+
+// =====================
+// Syzygy Tablebases
+// =====================
+
+/*
+  probing of syzygy wdl (.rtbw) and dtz (.rtbz) files
+
+  files are looked up when SyzygyPath is set but only mapped (read only,
+  shared) the first time a position with their material is probed, so only
+  the pages that are actually touched count towards the resident memory no
+  matter how many tables are on disk
+
+  squares and pieces use the syzygy conventions (a1 = 0, white pawn = 1 ..
+  white king = 6, black pieces + 8) and the tables are read as laid out by
+  the generator: an index is built from the piece squares, the block holding
+  it is found through a sparse index and decoded with a canonical huffman
+  code over recursively paired symbols
+*/
+
+#define tb_max_pieces 7
+
+// probe results
+enum { tb_fail = 0, tb_ok = 1, tb_change_stm = -1, tb_zeroing_best_move = 2 };
+
+// wdl results from the side to move's point of view
+enum { wdl_loss = -2, wdl_blessed_loss = -1, wdl_draw = 0, wdl_cursed_win = 1, wdl_win = 2 };
+
+// per table flags
+enum { tb_flag_stm = 1, tb_flag_mapped = 2, tb_flag_win_plies = 4, tb_flag_loss_plies = 8, tb_flag_wide = 16, tb_flag_single_value = 128 };
+
+// decoding data of one table (one side to move and leading file)
+typedef struct {
+  uint8_t flags;
+  uint8_t max_sym_len;
+  uint8_t min_sym_len;
+  uint32_t num_blocks;
+  uint64_t sizeof_block;
+  uint64_t span;
+  uint64_t sparse_index_size;
+  uint64_t block_length_size;
+  uint8_t* lowest_sym;
+  uint64_t* base64;
+  uint8_t* btree;
+  uint8_t* symlen;
+  int symlen_size;
+  uint8_t* sparse_index;
+  uint8_t* block_length;
+  uint8_t* data;
+  uint16_t map_idx[4];
+  uint8_t pieces[tb_max_pieces];
+  int group_len[tb_max_pieces + 1];
+  uint64_t group_idx[tb_max_pieces + 1];
+} pairs_data;
+
+// a mapped (or not yet mapped) wdl or dtz file
+typedef struct {
+  char* path;
+  atomic_int ready;
+  uint8_t* base;
+  size_t size;
+  uint8_t* map;
+  pairs_data items[2][4];
+} tb_file;
+
+// one material combination, e.g. KRPvKR
+typedef struct {
+  uint64_t key;
+  uint64_t key2;
+  int piece_count;
+  int has_pawns;
+  int has_unique_pieces;
+  int pawn_count[2];
+  tb_file wdl;
+  tb_file dtz;
+} tb_entry;
+
+#define tb_hash_size 16384
+
+tb_entry* tb_entries = NULL;
+int tb_entry_count = 0;
+
+// material key -> entry index + 1 (0 -> empty slot)
+int tb_hash[tb_hash_size];
+
+// most pieces in any table found (0 -> probing off)
+int tb_largest = 0;
+
+// guards lazy mapping of tables
+pthread_mutex_t tb_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// index encoding tables
+int map_b1h1h7[64];
+int map_a1d1d4[64];
+int map_kk[10][64];
+int binomial[6][64];
+int map_pawns[64];
+int lead_pawn_idx[6][64];
+int lead_pawns_size[6][4];
+
+// little endian reads (tables may be unaligned)
+static inline uint32_t tb_read_le32(const uint8_t* data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static inline uint16_t tb_read_le16(const uint8_t* data) {
+  return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+static inline uint32_t tb_read_be32(const uint8_t* data) {
+  return ((uint32_t)data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+// square distance below (< 0) or above (> 0) the a1-h8 diagonal
+static inline int off_a1h8(const int pos1D) {
+  return (pos1D >> 3) - (pos1D & 7);
+}
+
+// syzygy piece code of a piece of ours
+static inline int tb_piece_code(const int piece) {
+  return (piece % 6) + 1 + ((piece >= p) ? 8 : 0);
+}
+
+// piece on square (-1 if empty)
+static inline int piece_on(const int pos1D) {
+  for (int piece = P; piece <= k; ++piece) {
+    if (get_bit(piece_bitboards[piece], pos1D)) return piece;
+  }
+  return -1;
+}
+
+void init_tb_indices() {
+  int code = 0;
+
+  // b1-h1-h7 triangle (below the diagonal) to 0 .. 27
+  for (int pos1D = 0; pos1D < 64; ++pos1D) {
+    if (off_a1h8(pos1D) < 0) map_b1h1h7[pos1D] = code++;
+  }
+
+  // a1-d1-d4 triangle to 0 .. 9, diagonal squares last
+  int diagonal[4], diagonal_count = 0;
+  code = 0;
+  for (int pos1D = a1; pos1D <= d4; ++pos1D) {
+    if (off_a1h8(pos1D) < 0 && (pos1D & 7) <= 3) {
+      map_a1d1d4[pos1D] = code++;
+    }
+    else if (!off_a1h8(pos1D) && (pos1D & 7) <= 3) {
+      diagonal[diagonal_count++] = pos1D;
+    }
+  }
+  for (int i = 0; i < diagonal_count; ++i) {
+    map_a1d1d4[diagonal[i]] = code++;
+  }
+
+  // the 462 legal placements of two kings with the first one in the a1-d1-d4 triangle,
+  // both kings on the diagonal are encoded last
+  int both_on_diagonal[64][2], both_count = 0;
+  code = 0;
+  for (int idx = 0; idx < 10; ++idx) {
+    for (int s1 = a1; s1 <= d4; ++s1) {
+      if (map_a1d1d4[s1] != idx || (idx == 0 && s1 != b1)) continue;
+
+      for (int s2 = 0; s2 < 64; ++s2) {
+        if (((king_attacks[s1] | (1ULL << s1)) >> s2) & 1ULL) continue;
+
+        if (!off_a1h8(s1) && off_a1h8(s2) > 0) continue;
+
+        if (!off_a1h8(s1) && !off_a1h8(s2)) {
+          both_on_diagonal[both_count][0] = idx;
+          both_on_diagonal[both_count][1] = s2;
+          ++both_count;
+        }
+        else {
+          map_kk[idx][s2] = code++;
+        }
+      }
+    }
+  }
+  for (int i = 0; i < both_count; ++i) {
+    map_kk[both_on_diagonal[i][0]][both_on_diagonal[i][1]] = code++;
+  }
+
+  // binomial[k][n] ways to choose k of n squares
+  binomial[0][0] = 1;
+  for (int n = 1; n < 64; ++n) {
+    for (int k = 0; k < 6 && k <= n; ++k) {
+      binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) + (k < n ? binomial[k][n - 1] : 0);
+    }
+  }
+
+  // pawns on a2-h7 to 0 .. 47, the leading pawn is the one with the highest value
+  int available_squares = 47;
+  for (int lead_pawns_count = 1; lead_pawns_count <= 5; ++lead_pawns_count) {
+    for (int file = 0; file <= 3; ++file) {
+      int idx = 0;
+
+      for (int rank = 1; rank <= 6; ++rank) {
+        int pos1D = rank * 8 + file;
+
+        if (lead_pawns_count == 1) {
+          map_pawns[pos1D] = available_squares--;
+          map_pawns[pos1D ^ 7] = available_squares--;
+        }
+
+        lead_pawn_idx[lead_pawns_count][pos1D] = idx;
+        idx += binomial[lead_pawns_count - 1][map_pawns[pos1D]];
+      }
+
+      lead_pawns_size[lead_pawns_count][file] = idx;
+    }
+  }
+}
+
+// pairs data of a table for side to move and leading file
+static inline pairs_data* tb_get(tb_entry* e, tb_file* f, const int stm, const int file) {
+  return &f->items[(f == &e->dtz) ? 0 : stm][e->has_pawns ? file : 0];
+}
+
+// number of values below sym minus one, -1 if the pair tree is corrupt: a symbol outside
+// the table, a pair containing itself (visited 1 = in progress, 2 = done) or a length
+// symlen can't hold. every pair is longer than its halves, so decoding always terminates
+static int tb_set_symlen(pairs_data* d, const int sym, uint8_t* visited) {
+  visited[sym] = 1;
+
+  uint8_t* lr = d->btree + 3 * sym;
+  int right = (lr[2] << 4) | (lr[1] >> 4);
+
+  if (right == 0xfff) {
+    visited[sym] = 2;
+    return 0;
+  }
+
+  int left = ((lr[1] & 0xf) << 8) | lr[0];
+
+  if (left >= d->symlen_size || right >= d->symlen_size) return -1;
+
+  int children[2] = { left, right };
+
+  for (int i = 0; i < 2; ++i) {
+    if (visited[children[i]] == 1) return -1;
+
+    if (!visited[children[i]]) {
+      int length = tb_set_symlen(d, children[i], visited);
+      if (length < 0) return -1;
+      d->symlen[children[i]] = length;
+    }
+  }
+
+  int length = d->symlen[left] + d->symlen[right] + 1;
+  if (length > 0xff) return -1;
+
+  visited[sym] = 2;
+
+  return length;
+}
+
+// split leading pieces and same piece groups and compute the index factor of each group
+static void tb_set_groups(tb_entry* e, pairs_data* d, const int order[2], const int file) {
+  int n = 0;
+  int first_len = e->has_pawns ? 0 : (e->has_unique_pieces ? 3 : 2);
+
+  d->group_len[n] = 1;
+
+  for (int i = 1; i < e->piece_count; ++i) {
+    if (--first_len > 0 || d->pieces[i] == d->pieces[i - 1]) {
+      d->group_len[n]++;
+    }
+    else {
+      d->group_len[++n] = 1;
+    }
+  }
+
+  d->group_len[++n] = 0;
+
+  // pawns on both sides
+  int pp = e->has_pawns && e->pawn_count[1];
+  int next = pp ? 2 : 1;
+  int free_squares = 64 - d->group_len[0] - (pp ? d->group_len[1] : 0);
+  uint64_t idx = 1;
+
+  for (int k = 0; next < n || k == order[0] || k == order[1]; ++k) {
+    // leading pawns or pieces
+    if (k == order[0]) {
+      d->group_idx[0] = idx;
+      idx *= e->has_pawns ? lead_pawns_size[d->group_len[0]][file] : (e->has_unique_pieces ? 31332 : 462);
+    }
+    // remaining pawns
+    else if (k == order[1]) {
+      d->group_idx[1] = idx;
+      idx *= binomial[d->group_len[1]][48 - d->group_len[0]];
+    }
+    // remaining pieces
+    else {
+      d->group_idx[next] = idx;
+      idx *= binomial[d->group_len[next]][free_squares];
+      free_squares -= d->group_len[next++];
+    }
+  }
+
+  d->group_idx[n] = idx;
+}
+
+// read huffman and pairing header of a table, returns pointer past it (NULL if it doesn't fit the file)
+static uint8_t* tb_set_sizes(pairs_data* d, uint8_t* data, const uint8_t* end) {
+  if (data + 12 > end) return NULL;
+
+  d->flags = *data++;
+
+  // all positions store the same value
+  if (d->flags & tb_flag_single_value) {
+    d->num_blocks = 0;
+    d->span = 0;
+    d->sparse_index_size = 0;
+    d->block_length_size = 0;
+    d->max_sym_len = 0;
+    d->min_sym_len = *data++;
+    return data;
+  }
+
+  int groups = 0;
+  while (d->group_len[groups]) ++groups;
+  uint64_t tb_size = d->group_idx[groups];
+
+  d->sizeof_block = 1ULL << *data++;
+  d->span = 1ULL << *data++;
+  d->sparse_index_size = (tb_size + d->span - 1) / d->span;
+  int padding = *data++;
+  d->num_blocks = tb_read_le32(data);
+  data += 4;
+  d->block_length_size = (uint64_t)d->num_blocks + padding;
+  d->max_sym_len = *data++;
+  d->min_sym_len = *data++;
+  d->lowest_sym = data;
+
+  if (d->max_sym_len < d->min_sym_len) return NULL;
+
+  int base64_size = d->max_sym_len - d->min_sym_len + 1;
+  if (data + 2 * base64_size + 2 > end) return NULL;
+
+  d->base64 = (uint64_t*)calloc(base64_size, sizeof(uint64_t));
+
+  // canonical huffman: base64[i] is the lowest 64 bit left aligned code of length i + min_sym_len
+  for (int i = base64_size - 2; i >= 0; --i) {
+    d->base64[i] = (d->base64[i + 1] + tb_read_le16(d->lowest_sym + 2 * i) - tb_read_le16(d->lowest_sym + 2 * (i + 1))) / 2;
+  }
+  for (int i = 0; i < base64_size; ++i) {
+    int shift = 64 - i - d->min_sym_len;
+    d->base64[i] = (shift >= 64) ? 0 : d->base64[i] << shift;
+  }
+
+  data += 2 * base64_size;
+  d->symlen_size = tb_read_le16(data);
+  data += 2;
+  d->btree = data;
+
+  if (data + 3 * d->symlen_size > end) return NULL;
+
+  d->symlen = (uint8_t*)calloc(d->symlen_size ? d->symlen_size : 1, 1);
+  uint8_t* visited = (uint8_t*)calloc(d->symlen_size ? d->symlen_size : 1, 1);
+
+  for (int sym = 0; sym < d->symlen_size; ++sym) {
+    if (visited[sym]) continue;
+
+    int length = tb_set_symlen(d, sym, visited);
+
+    // corrupt pair tree, the table is rejected
+    if (length < 0) {
+      free(visited);
+      return NULL;
+    }
+
+    d->symlen[sym] = length;
+  }
+
+  free(visited);
+
+  return data + 3 * d->symlen_size + (d->symlen_size & 1);
+}
+
+// dtz value maps
+static uint8_t* tb_set_dtz_map(tb_entry* e, tb_file* f, uint8_t* data, const int max_file, const uint8_t* end) {
+  f->map = data;
+
+  for (int file = 0; file <= max_file; ++file) {
+    pairs_data* d = tb_get(e, f, 0, file);
+
+    if (!(d->flags & tb_flag_mapped)) continue;
+
+    if (d->flags & tb_flag_wide) {
+      data += (uintptr_t)data & 1;
+      for (int i = 0; i < 4; ++i) {
+        if (data + 2 > end) return NULL;
+        d->map_idx[i] = (uint16_t)((data - f->map) / 2 + 1);
+        data += 2 * tb_read_le16(data) + 2;
+      }
+    }
+    else {
+      for (int i = 0; i < 4; ++i) {
+        if (data + 1 > end) return NULL;
+        d->map_idx[i] = (uint16_t)(data - f->map + 1);
+        data += *data + 1;
+      }
+    }
+  }
+
+  return data + ((uintptr_t)data & 1);
+}
+
+// parse a mapped file (data points past the magic), returns 0 on a malformed file
+static int tb_init_file(tb_entry* e, tb_file* f, uint8_t* data, const int dtz) {
+  const uint8_t* end = f->base + f->size;
+
+  int split = *data & 1;
+  int has_pawns = (*data & 2) != 0;
+
+  if (has_pawns != e->has_pawns || (!dtz && split != (e->key != e->key2))) return 0;
+
+  ++data;
+
+  int sides = (!dtz && e->key != e->key2) ? 2 : 1;
+  int max_file = e->has_pawns ? 3 : 0;
+  int pp = e->has_pawns && e->pawn_count[1];
+
+  for (int file = 0; file <= max_file; ++file) {
+    int order[2][2] = {
+      { *data & 0xf, pp ? *(data + 1) & 0xf : 0xf },
+      { *data >> 4, pp ? *(data + 1) >> 4 : 0xf }
+    };
+    data += 1 + pp;
+
+    for (int piece = 0; piece < e->piece_count; ++piece, ++data) {
+      for (int i = 0; i < sides; ++i) {
+        f->items[i][file].pieces[piece] = i ? (*data >> 4) : (*data & 0xf);
+      }
+    }
+
+    for (int i = 0; i < sides; ++i) {
+      tb_set_groups(e, &f->items[i][file], order[i], file);
+    }
+  }
+
+  // word alignment
+  data += (uintptr_t)data & 1;
+
+  for (int file = 0; file <= max_file; ++file) {
+    for (int i = 0; i < sides; ++i) {
+      data = tb_set_sizes(&f->items[i][file], data, end);
+      if (data == NULL) return 0;
+    }
+  }
+
+  if (dtz) {
+    data = tb_set_dtz_map(e, f, data, max_file, end);
+    if (data == NULL) return 0;
+  }
+
+  for (int file = 0; file <= max_file; ++file) {
+    for (int i = 0; i < sides; ++i) {
+      f->items[i][file].sparse_index = data;
+      data += f->items[i][file].sparse_index_size * 6;
+    }
+  }
+
+  for (int file = 0; file <= max_file; ++file) {
+    for (int i = 0; i < sides; ++i) {
+      f->items[i][file].block_length = data;
+      data += f->items[i][file].block_length_size * 2;
+    }
+  }
+
+  for (int file = 0; file <= max_file; ++file) {
+    for (int i = 0; i < sides; ++i) {
+      // 64 byte alignment
+      data = (uint8_t*)(((uintptr_t)data + 0x3f) & ~(uintptr_t)0x3f);
+      f->items[i][file].data = data;
+      data += f->items[i][file].num_blocks * f->items[i][file].sizeof_block;
+    }
+  }
+
+  return data <= end;
+}
+
+// map a table file and parse its header, returns 0 if it is missing or malformed
+static int tb_map_file(tb_entry* e, tb_file* f, const int dtz) {
+  static const uint8_t magics[2][4] = { { 0x71, 0xe8, 0x23, 0x5d }, { 0xd7, 0x66, 0x0c, 0xa5 } };
+
+  int fd = open(f->path, O_RDONLY);
+  if (fd < 0) return 0;
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) || file_stat.st_size % 64 != 16) {
+    close(fd);
+    return 0;
+  }
+
+  f->size = file_stat.st_size;
+  f->base = (uint8_t*)mmap(NULL, f->size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (f->base == MAP_FAILED) {
+    f->base = NULL;
+    return 0;
+  }
+
+  // probes hit scattered pages, don't read ahead
+  madvise(f->base, f->size, MADV_RANDOM);
+
+  if (memcmp(f->base, magics[dtz], 4) != 0 || !tb_init_file(e, f, f->base + 4, dtz)) {
+    munmap(f->base, f->size);
+    f->base = NULL;
+    return 0;
+  }
+
+  return 1;
+}
+
+// map the file on first use
+static inline int tb_ready(tb_entry* e, tb_file* f, const int dtz) {
+  int ready = atomic_load_explicit(&f->ready, memory_order_acquire);
+
+  if (ready) return ready == 1;
+
+  pthread_mutex_lock(&tb_mutex);
+
+  ready = atomic_load_explicit(&f->ready, memory_order_relaxed);
+  if (!ready) {
+    ready = tb_map_file(e, f, dtz) ? 1 : -1;
+    atomic_store_explicit(&f->ready, ready, memory_order_release);
+  }
+
+  pthread_mutex_unlock(&tb_mutex);
+
+  return ready == 1;
+}
+
+// decode the value stored at index idx
+static int tb_decompress_pairs(pairs_data* d, const uint64_t idx) {
+  if (d->flags & tb_flag_single_value) return d->min_sym_len;
+
+  // the sparse index points into block_length for every span positions
+  uint32_t k = (uint32_t)(idx / d->span);
+
+  uint32_t block = tb_read_le32(d->sparse_index + 6 * k);
+  int offset = tb_read_le16(d->sparse_index + 6 * k + 4);
+
+  offset += (int)(idx % d->span) - (int)(d->span / 2);
+
+  // walk to the block holding idx
+  while (offset < 0) {
+    offset += tb_read_le16(d->block_length + 2 * (--block)) + 1;
+  }
+  while (offset > tb_read_le16(d->block_length + 2 * block)) {
+    offset -= tb_read_le16(d->block_length + 2 * block++) + 1;
+  }
+
+  uint8_t* ptr = d->data + (uint64_t)block * d->sizeof_block;
+
+  uint64_t buf64 = ((uint64_t)tb_read_be32(ptr) << 32) | tb_read_be32(ptr + 4);
+  ptr += 8;
+  int buf64_size = 64;
+  int sym;
+
+  while (1) {
+    int len = 0;
+
+    while (buf64 < d->base64[len]) ++len;
+
+    sym = (int)((buf64 - d->base64[len]) >> (64 - len - d->min_sym_len));
+    sym += tb_read_le16(d->lowest_sym + 2 * len);
+
+    if (offset < d->symlen[sym] + 1) break;
+
+    offset -= d->symlen[sym] + 1;
+    len += d->min_sym_len;
+    buf64 <<= len;
+    buf64_size -= len;
+
+    // refill
+    if (buf64_size <= 32) {
+      buf64_size += 32;
+      buf64 |= (uint64_t)tb_read_be32(ptr) << (64 - buf64_size);
+      ptr += 4;
+    }
+  }
+
+  // expand pairs down to the single value at offset
+  while (d->symlen[sym]) {
+    uint8_t* lr = d->btree + 3 * sym;
+    int left = ((lr[1] & 0xf) << 8) | lr[0];
+
+    if (offset < d->symlen[left] + 1) {
+      sym = left;
+    }
+    else {
+      offset -= d->symlen[left] + 1;
+      sym = (lr[2] << 4) | (lr[1] >> 4);
+    }
+  }
+
+  uint8_t* lr = d->btree + 3 * sym;
+  return ((lr[1] & 0xf) << 8) | lr[0];
+}
+
+// sort helpers
+static inline void tb_sort_by_map_pawns(int* squares, const int count) {
+  for (int i = 1; i < count; ++i) {
+    int pos1D = squares[i], j = i - 1;
+    while (j >= 0 && map_pawns[squares[j]] > map_pawns[pos1D]) {
+      squares[j + 1] = squares[j];
+      --j;
+    }
+    squares[j + 1] = pos1D;
+  }
+}
+
+static inline void tb_sort_squares(int* squares, const int count) {
+  for (int i = 1; i < count; ++i) {
+    int pos1D = squares[i], j = i - 1;
+    while (j >= 0 && squares[j] > pos1D) {
+      squares[j + 1] = squares[j];
+      --j;
+    }
+    squares[j + 1] = pos1D;
+  }
+}
+
+// dtz values are stored in moves or plies and may go through a value map
+static int tb_map_dtz_score(tb_entry* e, const int file, int value, const int wdl) {
+  static const int wdl_map[] = { 1, 3, 0, 2, 0 };
+
+  pairs_data* d = tb_get(e, &e->dtz, 0, file);
+
+  if (d->flags & tb_flag_mapped) {
+    if (d->flags & tb_flag_wide) {
+      value = tb_read_le16(e->dtz.map + 2 * (d->map_idx[wdl_map[wdl + 2]] + value));
+    }
+    else {
+      value = e->dtz.map[d->map_idx[wdl_map[wdl + 2]] + value];
+    }
+  }
+
+  if ((wdl == wdl_win && !(d->flags & tb_flag_win_plies)) || (wdl == wdl_loss && !(d->flags & tb_flag_loss_plies)) || wdl == wdl_cursed_win || wdl == wdl_blessed_loss) {
+    value *= 2;
+  }
+
+  return value + 1;
+}
+
+// look the current position up in its table
+static int tb_probe_table(const int dtz, int* result, const int wdl) {
+  // KvK
+  if (popcount(piece_color_mask[white_black]) == 2) return 0;
+
+  uint64_t key = material_key();
+  int slot = (int)((key * 0x9e3779b97f4a7c15ULL) >> 50) & (tb_hash_size - 1);
+
+  tb_entry* e = NULL;
+  while (tb_hash[slot]) {
+    tb_entry* candidate = &tb_entries[tb_hash[slot] - 1];
+    if (candidate->key == key || candidate->key2 == key) {
+      e = candidate;
+      break;
+    }
+    slot = (slot + 1) & (tb_hash_size - 1);
+  }
+
+  if (e == NULL || !tb_ready(e, dtz ? &e->dtz : &e->wdl, dtz)) {
+    *result = tb_fail;
+    return 0;
+  }
+
+  tb_file* f = dtz ? &e->dtz : &e->wdl;
+
+  int squares[tb_max_pieces], pieces[tb_max_pieces];
+  int size = 0, lead_pawns_count = 0, file = 0;
+  uint64_t lead_pawns = 0ULL, bitboard;
+
+  // files store the stronger side as white, and symmetric tables white to move only
+  int flip = (e->key == e->key2 && side == black) || key != e->key;
+  int flip_color = flip ? 8 : 0;
+  int flip_squares = flip ? 56 : 0;
+  int stm = flip ^ side;
+
+  // pawn tables are split by the file of the leading pawn
+  if (e->has_pawns) {
+    int lead_pawn = tb_get(e, f, 0, 0)->pieces[0] ^ flip_color;
+
+    lead_pawns = bitboard = piece_bitboards[(lead_pawn & 8) ? p : P];
+    while (bitboard) {
+      squares[size++] = LSB_index(bitboard) ^ flip_squares;
+      bitboard &= bitboard - 1;
+    }
+
+    lead_pawns_count = size;
+
+    int lead = 0;
+    for (int i = 1; i < lead_pawns_count; ++i) {
+      if (map_pawns[squares[i]] > map_pawns[squares[lead]]) lead = i;
+    }
+    int swap = squares[0]; squares[0] = squares[lead]; squares[lead] = swap;
+
+    file = squares[0] & 7;
+    if (file > 3) file = 7 - file;
+  }
+
+  // dtz tables store one side to move only
+  if (dtz) {
+    pairs_data* d = tb_get(e, f, stm, file);
+    if ((d->flags & tb_flag_stm) != stm && !(e->key == e->key2 && !e->has_pawns)) {
+      *result = tb_change_stm;
+      return 0;
+    }
+  }
+
+  bitboard = piece_color_mask[white_black] ^ lead_pawns;
+  while (bitboard) {
+    int pos1D = LSB_index(bitboard);
+    squares[size] = pos1D ^ flip_squares;
+    pieces[size++] = tb_piece_code(piece_on(pos1D)) ^ flip_color;
+    bitboard &= bitboard - 1;
+  }
+
+  pairs_data* d = tb_get(e, f, stm, file);
+
+  // order pieces as stored in the table
+  for (int i = lead_pawns_count; i < size - 1; ++i) {
+    for (int j = i; j < size; ++j) {
+      if (d->pieces[i] == pieces[j]) {
+        int swap = pieces[i]; pieces[i] = pieces[j]; pieces[j] = swap;
+        swap = squares[i]; squares[i] = squares[j]; squares[j] = swap;
+        break;
+      }
+    }
+  }
+
+  // leading piece to files a-d
+  if ((squares[0] & 7) > 3) {
+    for (int i = 0; i < size; ++i) squares[i] ^= 7;
+  }
+
+  uint64_t idx;
+
+  if (e->has_pawns) {
+    idx = lead_pawn_idx[lead_pawns_count][squares[0]];
+
+    tb_sort_by_map_pawns(squares + 1, lead_pawns_count - 1);
+
+    for (int i = 1; i < lead_pawns_count; ++i) {
+      idx += binomial[i][map_pawns[squares[i]]];
+    }
+  }
+  else {
+    // leading piece to ranks 1-4
+    if ((squares[0] >> 3) > 3) {
+      for (int i = 0; i < size; ++i) squares[i] ^= 56;
+    }
+
+    // first leading piece off the diagonal goes below it
+    for (int i = 0; i < d->group_len[0]; ++i) {
+      if (!off_a1h8(squares[i])) continue;
+
+      if (off_a1h8(squares[i]) > 0) {
+        for (int j = i; j < size; ++j) {
+          squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+        }
+      }
+      break;
+    }
+
+    if (e->has_unique_pieces) {
+      int adjust1 = squares[1] > squares[0];
+      int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+      if (off_a1h8(squares[0])) {
+        idx = ((uint64_t)map_a1d1d4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+      }
+      else if (off_a1h8(squares[1])) {
+        idx = (6 * 63 + (squares[0] >> 3) * 28 + map_b1h1h7[squares[1]]) * 62 + squares[2] - adjust2;
+      }
+      else if (off_a1h8(squares[2])) {
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + (squares[0] >> 3) * 7 * 28 + ((squares[1] >> 3) - adjust1) * 28 + map_b1h1h7[squares[2]];
+      }
+      else {
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + (squares[0] >> 3) * 7 * 6 + ((squares[1] >> 3) - adjust1) * 6 + ((squares[2] >> 3) - adjust2);
+      }
+    }
+    else {
+      idx = map_kk[map_a1d1d4[squares[0]]][squares[1]];
+    }
+  }
+
+  idx *= d->group_idx[0];
+
+  // remaining groups, squares mapped down past the squares of the previous groups
+  int* group_squares = squares + d->group_len[0];
+  int remaining_pawns = e->has_pawns && e->pawn_count[1];
+
+  for (int next = 1; d->group_len[next]; ++next) {
+    tb_sort_squares(group_squares, d->group_len[next]);
+
+    uint64_t n = 0;
+
+    for (int i = 0; i < d->group_len[next]; ++i) {
+      int adjust = 0;
+      for (int* s = squares; s < group_squares; ++s) adjust += group_squares[i] > *s;
+
+      n += binomial[i + 1][group_squares[i] - adjust - 8 * remaining_pawns];
+    }
+
+    remaining_pawns = 0;
+    idx += n * d->group_idx[next];
+    group_squares += d->group_len[next];
+  }
+
+  int value = tb_decompress_pairs(d, idx);
+
+  return dtz ? tb_map_dtz_score(e, file, value, wdl) : value - 2;
+}
+
+// resolve captures (and pawn moves for dtz) before trusting the table,
+// which may hold a don't care value when the best move zeroes the move counter
+static int tb_search(const int check_zeroing_moves, int* result) {
+  int value, best_value = wdl_loss;
+  int total_count = 0, move_count = 0;
+
+  moves move_list[1];
+  move_generation(move_list);
+
+  for (int i = 0; i < move_list->count; ++i) {
+    int move = move_list->moves[i];
+    int zeroing = get_move_capture(move) || (check_zeroing_moves && (get_move_piece(move) == P || get_move_piece(move) == p));
+
+    copy_board();
+
+    if (!make_move(move, all_moves)) continue;
+
+    ++total_count;
+
+    if (!zeroing) {
+      take_back();
+      continue;
+    }
+
+    ++move_count;
+
+    value = -tb_search(0, result);
+
+    take_back();
+
+    if (*result == tb_fail) return wdl_draw;
+
+    if (value > best_value) {
+      best_value = value;
+
+      if (value >= wdl_win) {
+        *result = tb_zeroing_best_move;
+        return value;
+      }
+    }
+  }
+
+  // all legal moves searched, the table value may be wrong (e.g. enpassant)
+  int no_more_moves = move_count && move_count == total_count;
+
+  if (no_more_moves) {
+    value = best_value;
+  }
+  else {
+    value = tb_probe_table(0, result, wdl_draw);
+    if (*result == tb_fail) return wdl_draw;
+  }
+
+  if (best_value >= value) {
+    *result = (best_value > wdl_draw || no_more_moves) ? tb_zeroing_best_move : tb_ok;
+    return best_value;
+  }
+
+  *result = tb_ok;
+  return value;
+}
+
+// win / draw / loss of the current position, *result is tb_fail if it couldn't be probed
+int tb_probe_wdl(int* result) {
+  *result = tb_ok;
+  return tb_search(0, result);
+}
+
+// dtz of a position that had a zeroing move played to reach a wdl result
+static inline int dtz_before_zeroing(const int wdl) {
+  return wdl == wdl_win ? 1 : wdl == wdl_cursed_win ? 101 : wdl == wdl_blessed_loss ? -101 : wdl == wdl_loss ? -1 : 0;
+}
+
+// distance to zeroing move in plies (> 0 win, < 0 loss, 0 draw)
+int tb_probe_dtz(int* result) {
+  *result = tb_ok;
+
+  int wdl = tb_search(1, result);
+
+  if (*result == tb_fail || wdl == wdl_draw) return 0;
+
+  if (*result == tb_zeroing_best_move) return dtz_before_zeroing(wdl);
+
+  int dtz = tb_probe_table(1, result, wdl);
+
+  if (*result == tb_fail) return 0;
+
+  if (*result != tb_change_stm) {
+    return (dtz + 100 * (wdl == wdl_blessed_loss || wdl == wdl_cursed_win)) * ((wdl > 0) ? 1 : -1);
+  }
+
+  // the table stores the other side to move, one ply search for the best dtz
+  int min_dtz = 0xffff;
+
+  moves move_list[1];
+  move_generation(move_list);
+
+  for (int i = 0; i < move_list->count; ++i) {
+    int move = move_list->moves[i];
+    int zeroing = get_move_capture(move) || get_move_piece(move) == P || get_move_piece(move) == p;
+
+    copy_board();
+
+    if (!make_move(move, all_moves)) continue;
+
+    dtz = zeroing ? -dtz_before_zeroing(tb_search(0, result)) : -tb_probe_dtz(result);
+
+    // mate in one
+    if (dtz == 1 && is_checkmate()) min_dtz = 1;
+
+    if (!zeroing) dtz += (dtz > 0) - (dtz < 0);
+
+    if (dtz < min_dtz && (dtz > 0) == (wdl > 0) && dtz != 0) min_dtz = dtz;
+
+    take_back();
+
+    if (*result == tb_fail) return 0;
+  }
+
+  return (min_dtz == 0xffff) ? -1 : min_dtz;
+}
+
+// keep only the root moves that preserve the best tablebase result, winning moves by
+// shortest dtz so the win is always converted before the fifty move rule, returns 0 if the root couldn't be probed
+// (root_list is left as it is then). a non empty root_list restricts the moves ranked
+int tb_rank_root_moves(moves* root_list) {
+  int ranks[256];
+  moves move_list[1];
+  moves legal_list[1];
+
+  if (!tb_largest || castle || popcount(piece_color_mask[white_black]) > tb_largest) return 0;
+
+  move_generation(move_list);
+  legal_list->count = 0;
+
+  int best_rank = -1000000;
+
+  for (int i = 0; i < move_list->count; ++i) {
+    int move = move_list->moves[i];
+    int result = tb_ok;
+    int dtz;
+
+    if (root_list->count && !move_in_list(root_list, move)) continue;
+
+    copy_board();
+
+    if (!make_move(move, all_moves)) continue;
+
+    if (get_move_capture(move) || get_move_piece(move) == P || get_move_piece(move) == p) {
+      dtz = dtz_before_zeroing(-tb_probe_wdl(&result));
+    }
+    else {
+      dtz = -tb_probe_dtz(&result);
+      dtz = (dtz > 0) ? dtz + 1 : (dtz < 0) ? dtz - 1 : 0;
+
+      // a mating move zeroes too, it must not rank below a winning pawn move or capture
+      if (dtz == 2 && is_checkmate()) dtz = 1;
+    }
+
+    take_back();
+
+    if (result == tb_fail) return 0;
+
+    // a win whose zeroing comes after the hundredth half move is only a draw unless the
+    // opponent errs, it ranks below the sure wins, a loss the fifty move rule may save
+    // ranks above the sure losses
+    int rank = (dtz > 0) ? ((dtz + halfmove_clock <= 100) ? 100000 - dtz : 50000 - dtz - halfmove_clock)
+             : (dtz < 0) ? ((halfmove_clock - dtz <= 100) ? -100000 - dtz : -50000 - dtz + halfmove_clock)
+             : 0;
+
+    ranks[legal_list->count] = rank;
+    add_move(legal_list, move);
+
+    if (rank > best_rank) best_rank = rank;
+  }
+
+  root_list->count = 0;
+
+  for (int i = 0; i < legal_list->count; ++i) {
+    if (ranks[i] == best_rank) add_move(root_list, legal_list->moves[i]);
+  }
+
+  return root_list->count > 0;
+}
+
+// release all tables
+void tb_free() {
+  for (int i = 0; i < tb_entry_count; ++i) {
+    tb_file* files[2] = { &tb_entries[i].wdl, &tb_entries[i].dtz };
+
+    for (int j = 0; j < 2; ++j) {
+      if (files[j]->base) munmap(files[j]->base, files[j]->size);
+
+      for (int side_index = 0; side_index < 2; ++side_index) {
+        for (int file = 0; file < 4; ++file) {
+          free(files[j]->items[side_index][file].base64);
+          free(files[j]->items[side_index][file].symlen);
+        }
+      }
+
+      free(files[j]->path);
+    }
+  }
+
+  free(tb_entries);
+  tb_entries = NULL;
+  tb_entry_count = 0;
+  tb_largest = 0;
+  memset(tb_hash, 0, sizeof(tb_hash));
+}
+
+// piece type letters as used in table file names
+const char tb_piece_chars[] = "PNBRQK";
+
+// register table for white pieces and black pieces (piece types P .. Q, strongest first) if its file exists
+static void tb_add(const char* paths, const int* white_pieces, const int white_count, const int* black_pieces, const int black_count) {
+  char name[32];
+  int length = 0;
+
+  name[length++] = 'K';
+  for (int i = 0; i < white_count; ++i) name[length++] = tb_piece_chars[white_pieces[i]];
+  name[length++] = 'v';
+  name[length++] = 'K';
+  for (int i = 0; i < black_count; ++i) name[length++] = tb_piece_chars[black_pieces[i]];
+  name[length] = '\0';
+
+  // find the file in one of the directories
+  char path[4096];
+  const char* dir = paths;
+  int found = 0;
+
+  while (*dir && !found) {
+    const char* dir_end = strchr(dir, ':');
+    int dir_length = dir_end ? (int)(dir_end - dir) : (int)strlen(dir);
+
+    snprintf(path, sizeof(path), "%.*s/%s.rtbw", dir_length, dir, name);
+    found = access(path, R_OK) == 0;
+
+    dir += dir_length;
+    if (*dir == ':') ++dir;
+  }
+
+  if (!found) return;
+
+  int counts[12] = { 0 };
+  counts[K] = counts[k] = 1;
+  for (int i = 0; i < white_count; ++i) ++counts[white_pieces[i]];
+  for (int i = 0; i < black_count; ++i) ++counts[black_pieces[i] + p];
+
+  uint64_t key = 0ULL, key2 = 0ULL;
+  for (int piece = P; piece <= K; ++piece) {
+    key |= (uint64_t)counts[piece] << (4 * piece);
+    key |= (uint64_t)counts[piece + p] << (4 * (piece + p));
+    key2 |= (uint64_t)counts[piece + p] << (4 * piece);
+    key2 |= (uint64_t)counts[piece] << (4 * (piece + p));
+  }
+
+  tb_entries = (tb_entry*)realloc(tb_entries, (tb_entry_count + 1) * sizeof(tb_entry));
+  tb_entry* e = &tb_entries[tb_entry_count];
+  memset(e, 0, sizeof(tb_entry));
+
+  e->key = key;
+  e->key2 = key2;
+  e->piece_count = 2 + white_count + black_count;
+  e->has_pawns = counts[P] || counts[p];
+
+  for (int piece = P; piece < K; ++piece) {
+    if (counts[piece] == 1 || counts[piece + p] == 1) e->has_unique_pieces = 1;
+  }
+
+  // the side with fewer pawns leads (if it has any)
+  int white_leads = !counts[p] || (counts[P] && counts[p] >= counts[P]);
+  e->pawn_count[0] = white_leads ? counts[P] : counts[p];
+  e->pawn_count[1] = white_leads ? counts[p] : counts[P];
+
+  e->wdl.path = strdup(path);
+  e->dtz.path = strdup(path);
+  memcpy(e->dtz.path + strlen(path) - 4, "rtbz", 4);
+
+  ++tb_entry_count;
+
+  // index both colorings
+  uint64_t keys[2] = { key, key2 };
+  for (int i = 0; i < 2; ++i) {
+    int slot = (int)((keys[i] * 0x9e3779b97f4a7c15ULL) >> 50) & (tb_hash_size - 1);
+    while (tb_hash[slot]) slot = (slot + 1) & (tb_hash_size - 1);
+    tb_hash[slot] = tb_entry_count;
+  }
+
+  if (e->piece_count > tb_largest) tb_largest = e->piece_count;
+}
+
+// all multisets of non king pieces for one side, strongest first
+static void tb_enumerate(const char* paths, int* white_pieces, const int white_count, int* black_pieces, const int black_count, const int enumerating_black, const int max_piece) {
+  if (white_count + black_count > tb_max_pieces - 2) return;
+
+  if (!enumerating_black) {
+    // every white set is tried with every black set
+    tb_enumerate(paths, white_pieces, white_count, black_pieces, 0, 1, Q);
+
+    for (int piece = max_piece; piece >= P; --piece) {
+      white_pieces[white_count] = piece;
+      tb_enumerate(paths, white_pieces, white_count + 1, black_pieces, 0, 0, piece);
+    }
+    return;
+  }
+
+  // files name the stronger side first, KvK has no file
+  if (white_count + black_count) tb_add(paths, white_pieces, white_count, black_pieces, black_count);
+
+  for (int piece = max_piece; piece >= P; --piece) {
+    black_pieces[black_count] = piece;
+    tb_enumerate(paths, white_pieces, white_count, black_pieces, black_count + 1, 1, piece);
+  }
+}
+
+// look up the tables in paths (directories separated by ':')
+void init_tablebases(const char* paths) {
+  tb_free();
+
+  if (paths == NULL || *paths == '\0' || strcmp(paths, "<empty>") == 0) return;
+
+  int white_pieces[tb_max_pieces], black_pieces[tb_max_pieces];
+  tb_enumerate(paths, white_pieces, 0, black_pieces, 0, 0, Q);
+
+  printf("info string found %d tablebases, up to %d pieces\n", tb_entry_count, tb_largest);
+}
+
+// =====================
+// Search
+// =====================
+
+#define infinity 50000
+#define mate_value 49000
+#define mate_score 48000
+
+// tablebase win, below any mate score
+#define tb_win_score 47000
+
+#define max_ply 64
+
+// mate scores are stored in the hash table relative to the current node
+// and converted back relative to the root when read
+
+// read hash entry, returns no_hash_entry if it can't be used for a cutoff
+static inline int read_hash_entry(const int alpha, const int beta, int* best_move, const int depth, const int ply) {
+  tt* hash_entry = hash_table_entry();
+
+  uint64_t key = hash_entry->key;
+  uint64_t data = hash_entry->data;
+
+  stat_add(tt_probes, 1);
+
+  if ((key ^ data) != hash_key) return no_hash_entry;
+
+  stat_add(tt_hits, 1);
+
+  // best move is used for move ordering even when the score can't be used
+  *best_move = get_hash_move(data);
+
+  if (get_hash_depth(data) >= depth) {
+    int score = get_hash_score(data);
+    if (score < -mate_score) score += ply;
+    if (score > mate_score) score -= ply;
+
+    int flag = get_hash_flag(data);
+
+    if (flag == hash_flag_exact) return score;
+    if ((flag == hash_flag_alpha) && (score <= alpha)) return alpha;
+    if ((flag == hash_flag_beta) && (score >= beta)) return beta;
+  }
+
+  return no_hash_entry;
+}
+
+// write hash entry, a deeper entry of another position from the current search is kept
+static inline void write_hash_entry(int score, const int best_move, const int depth, const int hash_flag, const int ply) {
+  tt* hash_entry = hash_table_entry();
+
+  uint64_t old_data = hash_entry->data;
+
+  if ((hash_entry->key ^ old_data) != hash_key && get_hash_generation(old_data) == current_hash_generation() && get_hash_depth(old_data) > depth + 2) {
+    return;
+  }
+
+  if (score < -mate_score) score -= ply;
+  if (score > mate_score) score += ply;
+
+  uint64_t data = pack_hash_data(score, best_move, depth, hash_flag);
+
+  hash_entry->key = hash_key ^ data;
+  hash_entry->data = data;
+}
+
+// selective search switches (1 -> on, 0 -> off)
+int null_move_pruning = 1;
+int late_move_reductions = 1;
+int reverse_futility_pruning = 1;
+int futility_pruning = 1;
+int late_move_pruning = 1;
+int razoring = 1;
+
+// pruning margins and limits [depth]
+const int reverse_futility_margin = 90;
+const int futility_margin[4] = { 0, 120, 220, 320 };
+const int razor_margin[4] = { 0, 250, 350, 450 };
+const int late_move_pruning_count[4] = { 0, 6, 10, 16 };
+
+// late move reductions [depth][moves searched]
+int lmr_table[max_ply][64];
+
+/*
+  most valuable victim & least valuable attacker
+
+    (Victims) Pawn Knight Bishop   Rook  Queen   King
+  (Attackers)
+        Pawn   105    205    305    405    505    605
+      Knight   104    204    304    404    504    604
+      Bishop   103    203    303    403    503    603
+        Rook   102    202    302    402    502    602
+       Queen   101    201    301    401    501    601
+        King   100    200    300    400    500    600
+*/
+const int mvv_lva[12][12] = {
+  { 105, 205, 305, 405, 505, 605,  105, 205, 305, 405, 505, 605 },
+  { 104, 204, 304, 404, 504, 604,  104, 204, 304, 404, 504, 604 },
+  { 103, 203, 303, 403, 503, 603,  103, 203, 303, 403, 503, 603 },
+  { 102, 202, 302, 402, 502, 602,  102, 202, 302, 402, 502, 602 },
+  { 101, 201, 301, 401, 501, 601,  101, 201, 301, 401, 501, 601 },
+  { 100, 200, 300, 400, 500, 600,  100, 200, 300, 400, 500, 600 },
+
+  { 105, 205, 305, 405, 505, 605,  105, 205, 305, 405, 505, 605 },
+  { 104, 204, 304, 404, 504, 604,  104, 204, 304, 404, 504, 604 },
+  { 103, 203, 303, 403, 503, 603,  103, 203, 303, 403, 503, 603 },
+  { 102, 202, 302, 402, 502, 602,  102, 202, 302, 402, 502, 602 },
+  { 101, 201, 301, 401, 501, 601,  101, 201, 301, 401, 501, 601 },
+  { 100, 200, 300, 400, 500, 600,  100, 200, 300, 400, 500, 600 }
+};
+
+// killer moves [id][ply]
+_Thread_local int killer_moves[2][max_ply];
+
+// history moves [piece][pos1D], decayed between searches
+_Thread_local int history_moves[12][64];
+
+// principal variation
+_Thread_local int pv_length[max_ply];
+_Thread_local int pv_table[max_ply][max_ply];
+
+// half move counter from the root
+_Thread_local int ply;
+
+// visited nodes
+_Thread_local uint64_t nodes;
+
+// score and depth of the last completed iteration
+_Thread_local int best_score;
+_Thread_local int completed_depth;
+
+// search thread id, 0 is the main search thread
+_Thread_local int thread_id;
+
+// print info lines while searching
+int print_search_info = 1;
+
+// root moves the search is restricted to (none -> all legal moves)
+moves root_moves;
+
+// tablebase probes that ended a search branch
+_Thread_local uint64_t tb_hits;
+
+#define max_multi_pv 64
+
+// number of principal variations the main search thread reports (uci option MultiPV)
+int multi_pv = 1;
+
+// principal variation of one multipv slot
+typedef struct {
+  int move;
+  int score;
+  int depth;
+  int pv_length;
+  int pv[max_ply];
+} root_line;
+
+// best lines of the search, best first
+_Thread_local root_line root_lines[max_multi_pv];
+
+// multipv slot being searched, the best moves of the earlier slots are skipped at the root
+_Thread_local int pv_index;
+
+// is move one of the root moves searched in the current multipv slot
+static inline int is_root_move(const int move) {
+  for (int i = 0; i < pv_index; ++i) {
+    if (root_lines[i].move == move) return 0;
+  }
+
+  return root_moves.count == 0 || move_in_list(&root_moves, move);
+}
+
+// set by the uci thread (stop), the time check or the main search thread when done
+atomic_int stop_search;
+
+// stop flag followed by the searches of this thread, independent searches (batch workers) use their own
+_Thread_local atomic_int* stop_flag = &stop_search;
+
+// limits of independent searches that differ per search (server analyses), 0 -> none
+_Thread_local uint64_t thread_stop_time;
+_Thread_local uint64_t thread_node_limit;
+
+// stop the search when out of time or nodes (main search thread only)
+static inline void check_limits() {
+  if (stop_time && !atomic_load_explicit(&pondering, memory_order_relaxed) && get_time_ms() >= stop_time) {
+    atomic_store(stop_flag, 1);
+  }
+  if (limits.nodes && nodes >= limits.nodes) {
+    atomic_store(stop_flag, 1);
+  }
+  if (thread_stop_time && get_time_ms() >= thread_stop_time) {
+    atomic_store(stop_flag, 1);
+  }
+  if (thread_node_limit && nodes >= thread_node_limit) {
+    atomic_store(stop_flag, 1);
+  }
+}
+
+// has the search been stopped
+static inline int search_stopped() {
+  return atomic_load_explicit(stop_flag, memory_order_relaxed);
+}
+
+// score move for move ordering
+static inline int score_move(const int move, const int hash_move) {
+  if (move == hash_move) return 30000;
+
+  if (get_move_capture(move)) {
+    // enpassant captures have no piece on the destination square
+    int victim = (side == white) ? p : P;
+
+    int start_piece = (side == white) ? p : P;
+    int end_piece = (side == white) ? k : K;
+
+    for (int bb_piece = start_piece; bb_piece <= end_piece; ++bb_piece) {
+      if (get_bit(piece_bitboards[bb_piece], get_move_destination(move))) {
+        victim = bb_piece;
+        break;
+      }
+    }
+
+    return mvv_lva[get_move_piece(move)][victim] + 10000;
+  }
+
+  if (killer_moves[0][ply] == move) return 9000;
+  if (killer_moves[1][ply] == move) return 8000;
+
+  return history_moves[get_move_piece(move)][get_move_destination(move)];
+}
+
+// sort moves in descending order of their score
+static inline void sort_moves(moves* move_list, const int hash_move) {
+  int move_scores[256];
+
+  for (int i = 0; i < move_list->count; ++i) {
+    move_scores[i] = score_move(move_list->moves[i], hash_move);
+  }
+
+  // insertion sort, move lists are short
+  for (int i = 1; i < move_list->count; ++i) {
+    int score = move_scores[i];
+    int move = move_list->moves[i];
+    int j = i - 1;
+
+    while (j >= 0 && move_scores[j] < score) {
+      move_scores[j + 1] = move_scores[j];
+      move_list->moves[j + 1] = move_list->moves[j];
+      --j;
+    }
+
+    move_scores[j + 1] = score;
+    move_list->moves[j + 1] = move;
+  }
+}
+
+// is the king of the given side in check
+static inline int in_check_side(const int side_to_check) {
+  return is_square_attacked(LSB_index(piece_bitboards[(side_to_check == white) ? K : k]), side_to_check ^ 1);
+}
+
+// does the side to move have anything besides king and pawns
+// (null move is unsafe without it because of zugzwang)
+static inline int has_non_pawn_material(const int side_to_check) {
+  if (side_to_check == white) {
+    return (piece_bitboards[N] | piece_bitboards[B] | piece_bitboards[R] | piece_bitboards[Q]) != 0ULL;
+  }
+  return (piece_bitboards[n] | piece_bitboards[b] | piece_bitboards[r] | piece_bitboards[q]) != 0ULL;
+}
+
+// search captures only until the position is quiet
+static inline int quiescence(int alpha, const int beta) {
+  if ((nodes & (time_check_interval - 1)) == 0 && thread_id == 0) check_limits();
+
+  ++nodes;
+  stat_add(quiescence_nodes, 1);
+
+  if (ply > max_ply - 1) return evaluate();
+
+  // stand pat
+  int evaluation = evaluate();
+
+  if (evaluation >= beta) return beta;
+  if (evaluation > alpha) alpha = evaluation;
+
+  moves move_list[1];
+  move_generation(move_list);
+  sort_moves(move_list, 0);
+
+  for (int i = 0; i < move_list->count; ++i) {
+    copy_board();
+    ++ply;
+
+    if (!make_move(move_list->moves[i], only_captures)) {
+      --ply;
+      continue;
+    }
+
+    int score = -quiescence(-beta, -alpha);
+
+    --ply;
+    take_back();
+
+    if (search_stopped()) return 0;
+
+    if (score > alpha) {
+      alpha = score;
+      if (score >= beta) return beta;
+    }
+  }
+
+  return alpha;
+}
+
+// negamax alpha beta search
+static inline int negamax(int alpha, const int beta, int depth, const int allow_null) {
+  // before any write to the per ply tables, check extensions can reach max_ply
+  if (ply > max_ply - 1) return evaluate();
+
+  pv_length[ply] = ply;
+
+  int score;
+  int hash_move = 0;
+  int hash_flag = hash_flag_alpha;
+  int pv_node = (beta - alpha > 1);
+
+  if (ply) {
+    // fifty move rule (a mate on the hundredth half move still counts) and
+    // repetitions, the side that repeats can hold the draw
+    if ((halfmove_clock >= 100 && !is_checkmate()) || is_repetition()) return 0;
+
+    // a position of the search path can be repeated with the next move, so this one is worth at least a draw
+    if (alpha < 0 && has_upcoming_repetition(ply)) {
+      alpha = 0;
+      if (alpha >= beta) return alpha;
+    }
+  }
+
+  // hash table cutoff (not at root and not in pv nodes)
+  if (ply && (score = read_hash_entry(alpha, beta, &hash_move, depth, ply)) != no_hash_entry && !pv_node) {
+    stat_add(tt_cutoffs, 1);
+    return score;
+  }
+
+  // tablebase cutoff, the tables assume no castling rights and a freshly zeroed
+  // fifty move counter (wdl says nothing about the half moves already spent)
+  if (ply && tb_largest && !castle && halfmove_clock == 0 && popcount(piece_color_mask[white_black]) <= tb_largest) {
+    int result;
+    int wdl = tb_probe_wdl(&result);
+
+    if (result != tb_fail) {
+      ++tb_hits;
+
+      // cursed wins and blessed losses are draws under the fifty move rule
+      score = (wdl == wdl_win) ? tb_win_score - ply : (wdl == wdl_loss) ? -tb_win_score + ply : 2 * wdl;
+
+      write_hash_entry(score, 0, (depth + 6 < max_ply) ? depth + 6 : max_ply - 1, hash_flag_exact, ply);
+
+      return score;
+    }
+  }
+
+  if (depth <= 0) return quiescence(alpha, beta);
+
+  // later multipv slots start with the best remaining line of the previous iteration
+  // (the hash move is the best move of the first slot, which is skipped)
+  if (ply == 0 && pv_index) {
+    for (int i = pv_index; i < max_multi_pv && root_lines[i].move; ++i) {
+      if (is_root_move(root_lines[i].move)) {
+        hash_move = root_lines[i].move;
+        break;
+      }
+    }
+  }
+
+  if ((nodes & (time_check_interval - 1)) == 0 && thread_id == 0) check_limits();
+
+  if (search_stopped()) return 0;
+
+  ++nodes;
+  stat_add(main_nodes, 1);
+
+  int in_check = in_check_side(side);
+
+  // check extension
+  if (in_check) ++depth;
+
+  int static_eval = evaluate();
+
+  if (!in_check && !pv_node) {
+    // reverse futility pruning (static null move): a quiet position far above beta
+    if (reverse_futility_pruning && depth <= 6 && abs(beta) < mate_score && static_eval - reverse_futility_margin * depth >= beta) {
+      return beta;
+    }
+
+    // adaptive null move pruning, skipped when only king and pawns are left
+    if (null_move_pruning && allow_null && depth >= 3 && static_eval >= beta && has_non_pawn_material(side)) {
+      int reduction = 3 + depth / 6;
+
+      stat_add(null_move_tries, 1);
+
+      copy_board();
+      ++ply;
+
+      // give the opponent a free move
+      push_key_history();
+      ++halfmove_clock;
+      plies_from_null = 0;
+      if (enpassant_pos1D != out_of_bounds_pos1D) hash_key ^= enpassant_keys[enpassant_pos1D];
+      enpassant_pos1D = out_of_bounds_pos1D;
+      side ^= 1;
+      hash_key ^= side_key;
+
+      score = -negamax(-beta, -beta + 1, depth - 1 - reduction, 0);
+
+      --ply;
+      take_back();
+
+      if (search_stopped()) return 0;
+
+      if (score >= beta) {
+        stat_add(null_move_cutoffs, 1);
+        return beta;
+      }
+    }
+
+    // razoring: drop into quiescence when far below alpha near the leaves
+    if (razoring && depth <= 3 && static_eval + razor_margin[depth] < alpha) {
+      score = quiescence(alpha, beta);
+      if (depth == 1 || score <= alpha) return score;
+    }
+  }
+
+  // futility pruning of quiet moves near the leaves
+  int futile = futility_pruning && depth <= 3 && !in_check && !pv_node && abs(alpha) < mate_score && static_eval + futility_margin[depth] <= alpha;
+
+  moves move_list[1];
+  move_generation(move_list);
+  sort_moves(move_list, hash_move);
+
+  int legal_moves = 0;
+  int moves_searched = 0;
+  int best_move = 0;
+
+  for (int i = 0; i < move_list->count; ++i) {
+    int move = move_list->moves[i];
+
+    if (ply == 0 && !is_root_move(move)) continue;
+
+    copy_board();
+    ++ply;
+
+    if (!make_move(move, all_moves)) {
+      --ply;
+      continue;
+    }
+
+    ++legal_moves;
+
+    int is_quiet = !get_move_capture(move) && !get_move_promoted(move);
+    int gives_check = in_check_side(side);
+
+    if (moves_searched && is_quiet && !gives_check && !in_check) {
+      // futility pruning
+      if (futile) {
+        --ply;
+        take_back();
+        continue;
+      }
+
+      // late move pruning
+      if (late_move_pruning && !pv_node && depth <= 3 && moves_searched >= late_move_pruning_count[depth]) {
+        --ply;
+        take_back();
+        continue;
+      }
+    }
+
+    // first move is searched with full window
+    if (moves_searched == 0) {
+      score = -negamax(-beta, -alpha, depth - 1, 1);
+    }
+    else {
+      // late move reductions
+      if (late_move_reductions && moves_searched >= 3 && depth >= 3 && is_quiet && !in_check && !gives_check) {
+        int reduction = lmr_table[depth < max_ply ? depth : max_ply - 1][moves_searched < 64 ? moves_searched : 63];
+        if (pv_node && reduction) --reduction;
+        if (depth - 1 - reduction < 1) reduction = depth - 2;
+
+        score = -negamax(-alpha - 1, -alpha, depth - 1 - reduction, 1);
+      }
+      // no reduction: force the null window search below
+      else {
+        score = alpha + 1;
+      }
+
+      // principal variation search
+      if (score > alpha) {
+        score = -negamax(-alpha - 1, -alpha, depth - 1, 1);
+
+        if (score > alpha && score < beta) {
+          score = -negamax(-beta, -alpha, depth - 1, 1);
+        }
+      }
+    }
+
+    --ply;
+    take_back();
+
+    if (search_stopped()) return 0;
+
+    ++moves_searched;
+
+    if (score > alpha) {
+      hash_flag = hash_flag_exact;
+      best_move = move;
+
+      if (is_quiet) history_moves[get_move_piece(move)][get_move_destination(move)] += depth * depth;
+
+      alpha = score;
+
+      // write pv move, a child at max_ply has no pv of its own
+      int child_pv_length = (ply + 1 < max_ply) ? pv_length[ply + 1] : ply + 1;
+
+      pv_table[ply][ply] = move;
+      for (int next_ply = ply + 1; next_ply < child_pv_length; ++next_ply) {
+        pv_table[ply][next_ply] = pv_table[ply + 1][next_ply];
+      }
+      pv_length[ply] = child_pv_length;
+
+      // fail high
+      if (score >= beta) {
+        stat_add(beta_cutoffs, 1);
+        stat_add(cutoff_index[(moves_searched < 8) ? moves_searched - 1 : 7], 1);
+
+        if (ply || pv_index == 0) write_hash_entry(beta, move, depth, hash_flag_beta, ply);
+
+        if (is_quiet) {
+          killer_moves[1][ply] = killer_moves[0][ply];
+          killer_moves[0][ply] = move;
+        }
+
+        return beta;
+      }
+    }
+  }
+
+  // checkmate or stalemate
+  if (legal_moves == 0) {
+    return in_check ? -mate_value + ply : 0;
+  }
+
+  // the root entry of a later multipv slot would replace the best move of the first slot
+  if (ply || pv_index == 0) write_hash_entry(alpha, best_move, depth, hash_flag, ply);
+
+  return alpha;
+}
+
+// print uci info line of a root line, multipv is only shown when there are several lines
+void print_info_line(const int line_index, const int line_count) {
+  uint64_t time = get_time_ms() - start_time;
+  const root_line* line = &root_lines[line_index];
+  int score = line->score;
+
+  printf("info ");
+  if (line_count > 1) printf("multipv %d ", line_index + 1);
+
+  if (score > -mate_value && score < -mate_score) {
+    printf("score mate %d depth %d", -(score + mate_value) / 2 - 1, line->depth);
+  }
+  else if (score > mate_score && score < mate_value) {
+    printf("score mate %d depth %d", (mate_value - score) / 2 + 1, line->depth);
+  }
+  else {
+    printf("score cp %d depth %d", score, line->depth);
+  }
+
+  printf(" nodes %llu nps %llu time %llu pv ", (unsigned long long)nodes, (unsigned long long)(nodes * 1000 / (time + 1)), (unsigned long long)time);
+
+  for (int i = 0; i < line->pv_length; ++i) {
+    print_move(line->pv[i]);
+    printf(" ");
+  }
+  printf("\n");
+}
+
+// number of legal root moves the search may play
+int count_root_moves() {
+  moves move_list[1];
+  move_generation(move_list);
+
+  int count = 0;
+
+  for (int i = 0; i < move_list->count; ++i) {
+    copy_board();
+
+    if (!make_move(move_list->moves[i], all_moves)) continue;
+
+    take_back();
+
+    if (is_root_move(move_list->moves[i])) ++count;
+  }
+
+  return count;
+}
+
+// first legal root move, played when the search is stopped before depth 1 completes (0 if there is none)
+int first_root_move() {
+  moves move_list[1];
+  move_generation(move_list);
+
+  for (int i = 0; i < move_list->count; ++i) {
+    copy_board();
+
+    if (!make_move(move_list->moves[i], all_moves)) continue;
+
+    take_back();
+
+    if (is_root_move(move_list->moves[i])) return move_list->moves[i];
+  }
+
+  return 0;
+}
+
+// clear the move ordering history of the calling thread (new game)
+void clear_move_history() {
+  memset(history_moves, 0, sizeof(history_moves));
+}
+
+// clear the per search state of the calling thread, history decays instead
+void reset_search_state() {
+  for (int piece = P; piece <= k; ++piece) {
+    for (int pos1D = 0; pos1D < 64; ++pos1D) history_moves[piece][pos1D] /= 4;
+  }
+
+  nodes = 0;
+  tb_hits = 0;
+  best_score = 0;
+  completed_depth = 0;
+  ply = 0;
+  memset(killer_moves, 0, sizeof(killer_moves));
+  memset(pv_table, 0, sizeof(pv_table));
+  memset(pv_length, 0, sizeof(pv_length));
+}
+
+// search position up to the given depth with iterative deepening, returns the best move
+int search_position(const int depth) {
+  int score = 0;
+  int best_move = 0;
+
+  reset_search_state();
+
+  if (thread_id == 0) {
+    reset_time_manager();
+    new_hash_generation();
+  }
+
+  // helper threads only search the best line
+  int line_count = (thread_id == 0) ? multi_pv : 1;
+
+  if (line_count > 1) {
+    int root_move_count = count_root_moves();
+    if (line_count > root_move_count) line_count = root_move_count;
+    if (line_count < 1) line_count = 1;
+  }
+
+  memset(root_lines, 0, sizeof(root_lines));
+
+  // odd helper threads start one ply deeper so the threads don't search in lockstep
+  for (int current_depth = 1 + (thread_id & 1); current_depth <= depth; ++current_depth) {
+    int completed_lines = 0;
+
+    // the slots share the iteration, the hash table, killers and history:
+    // each one searches the root without the best moves of the slots before it
+    for (pv_index = 0; pv_index < line_count; ++pv_index) {
+      // a later slot can't score above the one before it unless the search is unstable
+      int beta = pv_index ? root_lines[pv_index - 1].score + 1 : infinity;
+
+      score = negamax(-infinity, beta, current_depth, 1);
+
+      if (score >= beta && !search_stopped()) score = negamax(-infinity, infinity, current_depth, 1);
+
+      // aborted iteration, keep the lines of the last completed one
+      if (search_stopped()) break;
+
+      root_line* line = &root_lines[pv_index];
+      line->move = pv_table[0][0];
+      line->score = score;
+      line->depth = current_depth;
+      line->pv_length = pv_length[0];
+      memcpy(line->pv, pv_table[0], pv_length[0] * sizeof(int));
+
+      ++completed_lines;
+    }
+
+    pv_index = 0;
+
+    if (completed_lines == 0) break;
+
+    // later slots can score above earlier ones because of search instability
+    for (int i = 1; i < completed_lines; ++i) {
+      root_line line = root_lines[i];
+      int j = i - 1;
+
+      while (j >= 0 && root_lines[j].score < line.score) {
+        root_lines[j + 1] = root_lines[j];
+        --j;
+      }
+
+      root_lines[j + 1] = line;
+    }
+
+    best_move = root_lines[0].move;
+    best_score = score = root_lines[0].score;
+    completed_depth = current_depth;
+
+    // a stopped iteration only shows its completed slots, the later ones still hold
+    // lines of the previous iteration that may repeat a move listed above them
+    if (thread_id == 0 && print_search_info) {
+      for (int i = 0; i < completed_lines; ++i) print_info_line(i, line_count);
+    }
+
+    if (search_stopped()) break;
+
+    if (thread_id == 0 && stop_iterating(best_move, score, current_depth)) break;
+  }
+
+  // stopped before any iteration completed
+  if (best_move == 0) best_move = first_root_move();
+
+  stats_merge();
+
+  return best_move;
+}
+
+// nodes and time to depth over the debug positions with each selective search technique switched off in turn
+void selective_search_report(const int depth) {
+  char* positions[] = { start_position, tricky_position, killer_position, cmk_position };
+  const char* names[] = { "all on", "no null move", "no lmr", "no reverse futility", "no futility", "no late move pruning", "no razoring" };
+  int* switches[] = { NULL, &null_move_pruning, &late_move_reductions, &reverse_futility_pruning, &futility_pruning, &late_move_pruning, &razoring };
+
+  print_search_info = 0;
+  limits = (search_limits){ .depth = depth };
+  start_time = get_time_ms();
+  stop_time = 0;
+  soft_time_limit = 0;
+  atomic_store(&stop_search, 0);
+
+  printf("\n    Selective search report (depth %d)\n\n", depth);
+
+  for (int config = 0; config < 7; ++config) {
+    uint64_t total_nodes = 0;
+    uint64_t start = get_time_ms();
+
+    if (switches[config]) *switches[config] = 0;
+
+    for (int i = 0; i < 4; ++i) {
+      parse_FEN(positions[i]);
+      clear_hash_table();
+      search_position(depth);
+      total_nodes += nodes;
+    }
+
+    if (switches[config]) *switches[config] = 1;
+
+    printf("    %-22s nodes %10llu   time %6llu ms\n", names[config], (unsigned long long)total_nodes, (unsigned long long)(get_time_ms() - start));
+  }
+
+  printf("\n");
+  print_search_info = 1;
+}
+
+// =====================
+// Init 
+// =====================
+
+void init_magic_numbers() {
+  printf("Rook \n");
+  for (int pos1D = 0; pos1D < 64; pos1D++) {
+    printf("0x%llxULL,\n", magic_number(pos1D, rook_occupancy_setbits[pos1D], 0));
+  }
+  printf("Bishop \n");
+  for (int pos1D = 0; pos1D < 64; pos1D++) {
+    printf("0x%llxULL,\n", magic_number(pos1D, bishop_occupancy_setbits[pos1D], 1));
+  }
+}
+
+void init_piece_occupancy_setbits() {
+  printf("rook\n");
+  for (int rank = 7; rank > -1; --rank) {
+    for (int file = 0; file < 8; ++file) {
+      int pos1D = 8*rank + file;
+      printf(" %d,", popcount(mask_rook_occupancy(pos1D)));
+    }
+    printf("\n");
+  }
+
+  printf("bishop");
+  for (int rank = 7; rank > -1; --rank) {
+    for (int file = 0; file < 8; ++file) {
+      int pos1D = 8*rank + file;
+      printf(" %d,", popcount(mask_bishop_occupancy(pos1D)));
+    }
+    printf("\n");
+  }
+
+}
+
+void init_leapers() {
+  for (int square = 0; square < 64; square++) {
+    // init pawn attacks
+    pawn_attacks[white][square] = mask_pawn_attacks(white, square);
+    pawn_attacks[black][square] = mask_pawn_attacks(black, square);
+    
+    // init knight attacks
+    knight_attacks[square] = mask_knight_attacks(square);
+    
+    // init king attacks
+    king_attacks[square] = mask_king_attacks(square);
+  }
+}
+
+void init_sliders() {
+  for (int pos1D = 0; pos1D <64; ++pos1D) {
+    int set_bits;
+    int possible_combinations;
+    int hash_index;
+    // bishop
+    // occupancy mask
+    bishop_masks[pos1D] = mask_bishop_occupancy(pos1D);
+    set_bits = bishop_occupancy_setbits[pos1D];
+    possible_combinations = (1 << set_bits);
+
+    // iterating through all possible occupancies 
+    for (int ith = 0; ith < possible_combinations; ++ith) {
+      uint64_t ith_occupancy = ith_occupancy_combination(ith, set_bits, bishop_masks[pos1D]);
+
+      // hashed index
+      hash_index = (ith_occupancy * bishop_magic_numbers[pos1D]) >> (64 - set_bits);
+
+      // set bishop attacks
+      bishop_attacks[pos1D][hash_index] = mask_bishop_attacks_given_occupancy(pos1D, ith_occupancy);
+      
+    }
+    // rook
+    // occupancy mask
+    rook_masks[pos1D] = mask_rook_occupancy(pos1D);
+    set_bits = rook_occupancy_setbits[pos1D];
+    possible_combinations = (1 << set_bits);
+
+    // iterating through all possible occupancies 
+    for (int ith = 0; ith < possible_combinations; ++ith) {
+      uint64_t ith_occupancy = ith_occupancy_combination(ith, set_bits, rook_masks[pos1D]);
+
+      // hashed index
+      hash_index = (ith_occupancy * rook_magic_numbers[pos1D]) >> (64 - set_bits);
+
+      // set rook attacks
+      rook_attacks[pos1D][hash_index] = mask_rook_attacks_given_occupancy(pos1D, ith_occupancy);
+      
+
+    }
+  }
+}
+
+void init_random_keys() {
+  for (int piece = P; piece <= k; ++piece) {
+    for (int pos1D = 0; pos1D < 64; ++pos1D) {
+      piece_keys[piece][pos1D] = random_U64_number();
+    }
+  }
+
+  for (int pos1D = 0; pos1D < 64; ++pos1D) {
+    enpassant_keys[pos1D] = random_U64_number();
+  }
+
+  for (int i = 0; i < 16; ++i) {
+    castle_keys[i] = random_U64_number();
+  }
+
+  side_key = random_U64_number();
+}
+
+void init_lmr_table() {
+  for (int depth = 0; depth < max_ply; ++depth) {
+    for (int moves_searched = 0; moves_searched < 64; ++moves_searched) {
+      if (depth == 0 || moves_searched == 0) {
+        lmr_table[depth][moves_searched] = 0;
+        continue;
+      }
+      // reductions grow with the log of both depth and move number
+      lmr_table[depth][moves_searched] = (int)(0.75 + log(depth) * log(moves_searched) / 2.25);
+    }
+  }
+}
+
+// tables of the move generator and the evaluation (all the library needs)
+void init_tables() {
+  init_leapers();
+  // init_piece_occupancy_setbits(); -> stored in array already
+  // init_magic_numbers(); -> stored in array already
+  init_sliders();
+  init_random_keys();
+  init_kpk_bitbase();
+}
+
+void init() {
+  init_tables();
+  init_lmr_table();
+  init_cuckoo();
+  init_tb_indices();
+  init_hash_table(64);
+}
+
+// =====================
+// Opening Book
+// =====================
+
+/*
+  polyglot .bin book reader
+
+  the book is mmapped and never read as a whole: entries are 16 bytes
+  (big endian key, move, weight, learn) sorted by key, so a position costs
+  one binary search over the mapping and a few page touches
+
+  keys use the 781 polyglot random numbers of polyglot_random.h, the table
+  published with the polyglot book format. the keys of the format's test
+  positions are checked before a book is opened
+*/
+
+#include "polyglot_random.h"
+
+#define polyglot_castle_offset 768
+#define polyglot_enpassant_offset 772
+#define polyglot_turn_offset 780
+
+// uci options OwnBook and BookBestMove
+int own_book = 0;
+int book_best_move = 0;
+
+uint8_t* book_data = NULL;
+size_t book_size = 0;
+uint64_t book_entries = 0;
+
+// book move choice, shared by searches started from the uci thread
+uint64_t book_random_state = 0x9e3779b97f4a7c15ULL;
+
+// polyglot key of the current position
+uint64_t polyglot_key() {
+  uint64_t key = 0ULL;
+
+  for (int piece = P; piece <= k; ++piece) {
+    uint64_t bitboard = piece_bitboards[piece];
+
+    // polyglot orders pieces black pawn, white pawn, black knight, ...
+    int kind = 2 * (piece % 6) + (piece < p);
+
+    while (bitboard) {
+      key ^= polyglot_random[64 * kind + LSB_index(bitboard)];
+      bitboard &= bitboard - 1;
+    }
+  }
+
+  if (castle & wck) key ^= polyglot_random[polyglot_castle_offset + 0];
+  if (castle & wcq) key ^= polyglot_random[polyglot_castle_offset + 1];
+  if (castle & bck) key ^= polyglot_random[polyglot_castle_offset + 2];
+  if (castle & bcq) key ^= polyglot_random[polyglot_castle_offset + 3];
+
+  // enpassant only counts when a pawn can actually capture
+  if (enpassant_pos1D != out_of_bounds_pos1D) {
+    uint64_t capturing_pawns = (side == white)
+      ? pawn_attacks[black][enpassant_pos1D] & piece_bitboards[P]
+      : pawn_attacks[white][enpassant_pos1D] & piece_bitboards[p];
+
+    if (capturing_pawns) key ^= polyglot_random[polyglot_enpassant_offset + (enpassant_pos1D & 7)];
+  }
+
+  if (side == white) key ^= polyglot_random[polyglot_turn_offset];
+
+  return key;
+}
+
+// test positions of the polyglot book format and their keys
+typedef struct {
+  char* fen;
+  uint64_t key;
+} polyglot_test;
+
+const polyglot_test polyglot_tests[] = {
+  { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0x463b96181691fc9cULL },
+  { "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823c9b50fd114196ULL },
+  { "rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756b94461c50fb0ULL },
+  { "rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662fafb965db29d4ULL },
+  { "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22a48b5a8e47ff78ULL },
+  { "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652a607ca3f242c1ULL },
+  { "rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00fdd303c946bdd9ULL },
+  { "rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3c8123ea7b067637ULL },
+  { "rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5c3f9b829b279560ULL }
+};
+
+#define polyglot_test_count (int)(sizeof(polyglot_tests) / sizeof(polyglot_tests[0]))
+
+// do the keys of the test positions match the format, the current position is kept
+int check_polyglot_keys() {
+  position current;
+  save_position(&current);
+
+  int passed = 1;
+
+  for (int i = 0; i < polyglot_test_count && passed; ++i) {
+    parse_FEN(polyglot_tests[i].fen);
+
+    if (polyglot_key() != polyglot_tests[i].key) {
+      printf("info string polyglot key %016llx of test position %d should be %016llx\n",
+        (unsigned long long)polyglot_key(), i + 1, (unsigned long long)polyglot_tests[i].key);
+      passed = 0;
+    }
+  }
+
+  load_position(&current);
+
+  return passed;
+}
+
+static inline uint64_t book_read_be(const uint8_t* data, const int bytes) {
+  uint64_t value = 0ULL;
+  for (int i = 0; i < bytes; ++i) value = (value << 8) | data[i];
+  return value;
+}
+
+void close_book() {
+  if (book_data) munmap(book_data, book_size);
+
+  book_data = NULL;
+  book_size = 0;
+  book_entries = 0;
+}
+
+// map the book file, returns 0 on failure
+int open_book(const char* path) {
+  close_book();
+
+  if (path == NULL || *path == '\0' || strcmp(path, "<empty>") == 0) return 0;
+
+  if (!check_polyglot_keys()) {
+    printf("info string polyglot keys don't match the book format, book disabled\n");
+    return 0;
+  }
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    printf("info string can't open book %s\n", path);
+    return 0;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) || file_stat.st_size < 16) {
+    close(fd);
+    return 0;
+  }
+
+  book_size = file_stat.st_size;
+  book_data = (uint8_t*)mmap(NULL, book_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (book_data == MAP_FAILED) {
+    book_data = NULL;
+    book_size = 0;
+    return 0;
+  }
+
+  madvise(book_data, book_size, MADV_RANDOM);
+  book_entries = book_size / 16;
+
+  printf("info string book %s, %llu entries\n", path, (unsigned long long)book_entries);
+
+  return 1;
+}
+
+// legal move of the current position for a polyglot move, 0 if there is none
+int book_to_move(const int book_move) {
+  int destination_pos1D = book_move & 63;
+  int source_pos1D = (book_move >> 6) & 63;
+  int promotion = (book_move >> 12) & 7;
+
+  // castling is stored as king takes own rook
+  if (source_pos1D == e1 && get_bit(piece_bitboards[K], e1)) {
+    if (destination_pos1D == h1) destination_pos1D = g1;
+    else if (destination_pos1D == a1) destination_pos1D = c1;
+  }
+  else if (source_pos1D == e8 && get_bit(piece_bitboards[k], e8)) {
+    if (destination_pos1D == h8) destination_pos1D = g8;
+    else if (destination_pos1D == a8) destination_pos1D = c8;
+  }
+
+  // none, knight, bishop, rook, queen
+  static const char promotion_chars[] = { 0, 'n', 'b', 'r', 'q' };
+
+  moves move_list[1];
+  move_generation(move_list);
+
+  for (int i = 0; i < move_list->count; ++i) {
+    int move = move_list->moves[i];
+
+    if (get_move_source(move) != source_pos1D || get_move_destination(move) != destination_pos1D) continue;
+
+    int promoted_piece = get_move_promoted(move);
+    if (promotion > 4 || (promoted_piece ? promoted_pieces[promoted_piece] : 0) != promotion_chars[promotion]) continue;
+
+    // legality
+    copy_board();
+    if (!make_move(move, all_moves)) continue;
+    take_back();
+
+    return move;
+  }
+
+  return 0;
+}
+
+// book moves and weights of the current position, returns their count
+int book_moves(int* move_array, int* weights, const int max_count) {
+  if (book_data == NULL) return 0;
+
+  uint64_t key = polyglot_key();
+
+  // first entry with the key
+  uint64_t low = 0, high = book_entries;
+  while (low < high) {
+    uint64_t middle = low + (high - low) / 2;
+    if (book_read_be(book_data + 16 * middle, 8) < key) low = middle + 1;
+    else high = middle;
+  }
+
+  int count = 0;
+
+  for (uint64_t i = low; i < book_entries && count < max_count; ++i) {
+    const uint8_t* entry = book_data + 16 * i;
+
+    if (book_read_be(entry, 8) != key) break;
+
+    int move = book_to_move((int)book_read_be(entry + 8, 2));
+    int weight = (int)book_read_be(entry + 10, 2);
+
+    if (move == 0 || weight == 0) continue;
+
+    move_array[count] = move;
+    weights[count] = weight;
+    ++count;
+  }
+
+  return count;
+}
+
+// book move for the current position (heaviest or weighted random), 0 if out of book
+int book_move() {
+  int move_array[64], weights[64];
+  int count = book_moves(move_array, weights, 64);
+
+  if (count == 0) return 0;
+
+  int best = 0;
+  int total_weight = 0;
+
+  for (int i = 0; i < count; ++i) {
+    if (weights[i] > weights[best]) best = i;
+    total_weight += weights[i];
+  }
+
+  if (book_best_move) return move_array[best];
+
+  // xorshift64
+  book_random_state ^= book_random_state << 13;
+  book_random_state ^= book_random_state >> 7;
+  book_random_state ^= book_random_state << 17;
+
+  int choice = (int)(book_random_state % (uint64_t)total_weight);
+
+  for (int i = 0; i < count; ++i) {
+    if (choice < weights[i]) return move_array[i];
+    choice -= weights[i];
+  }
+
+  return move_array[best];
+}
+
+// print book moves of the current position
+void print_book_moves() {
+  int move_array[64], weights[64];
+  int count = book_moves(move_array, weights, 64);
+
+  printf("\n    key %016llx, %d book moves\n\n", (unsigned long long)polyglot_key(), count);
+
+  for (int i = 0; i < count; ++i) {
+    printf("    ");
+    print_move(move_array[i]);
+    printf("  weight %d\n", weights[i]);
+  }
+  printf("\n");
+}
+
+// =====================
+// Threads
+// =====================
+
+#define max_threads 64
+
+// number of search threads (uci option Threads)
+int thread_count = 1;
+
+// position every search thread starts from
+position root_position;
+
+pthread_t helper_threads[max_threads];
+int helper_thread_ids[max_threads];
+
+// sleep for the given number of milliseconds
+void sleep_ms(const int ms) {
+  struct timespec duration = { ms / 1000, (ms % 1000) * 1000000L };
+  nanosleep(&duration, NULL);
+}
+
+// move ordering history of every search thread, search threads are started for each
+// search so the history is kept here between the searches of a game
+int saved_history_moves[max_threads][12][64];
+
+void load_move_history() {
+  memcpy(history_moves, saved_history_moves[thread_id], sizeof(history_moves));
+}
+
+void save_move_history() {
+  memcpy(saved_history_moves[thread_id], history_moves, sizeof(history_moves));
+}
+
+void clear_saved_move_history() {
+  memset(saved_history_moves, 0, sizeof(saved_history_moves));
+}
+
+// lazy smp helper, searches the root position and only shares its results through the hash table
+void* helper_thread_main(void* arg) {
+  thread_id = *(int*)arg;
+  load_position(&root_position);
+  load_move_history();
+
+  search_position(limits.depth);
+
+  save_move_history();
+
+  return NULL;
+}
+
+// search root_position on thread_count threads, returns the best move of the main search thread
+int parallel_search() {
+  thread_id = 0;
+  load_position(&root_position);
+  load_move_history();
+
+  // only the searchmoves are searched, in a tablebase position only those keeping the best result
+  root_moves = limits.search_moves;
+  tb_rank_root_moves(&root_moves);
+
+  for (int i = 1; i < thread_count; ++i) {
+    helper_thread_ids[i] = i;
+    pthread_create(&helper_threads[i], NULL, helper_thread_main, &helper_thread_ids[i]);
+  }
+
+  int best_move = search_position(limits.depth);
+
+  save_move_history();
+
+  // bestmove can't be sent in infinite or ponder mode before stop or ponderhit
+  while (!search_stopped() && (limits.infinite || atomic_load(&pondering))) {
+    sleep_ms(1);
+  }
+
+  atomic_store(&stop_search, 1);
+
+  for (int i = 1; i < thread_count; ++i) {
+    pthread_join(helper_threads[i], NULL);
+  }
+
+  print_stats_report("info string ");
+
+  return best_move;
+}
+
+// expected reply to best move for pondering: second move of the pv, or the hash
+// move of the position after best move when the pv is cut short (0 if none)
+int get_ponder_move(const int best_move) {
+  if (best_move == 0) return 0;
+
+  if (root_lines[0].move == best_move && root_lines[0].pv_length > 1) return root_lines[0].pv[1];
+
+  int ponder_move = 0;
+
+  copy_board();
+
+  if (make_move(best_move, all_moves)) {
+    tt* hash_entry = hash_table_entry();
+    int hash_move = ((hash_entry->key ^ hash_entry->data) == hash_key) ? get_hash_move(hash_entry->data) : 0;
+
+    moves move_list[1];
+    move_generation(move_list);
+
+    if (hash_move && move_in_list(move_list, hash_move)) {
+      copy_board();
+      if (make_move(hash_move, all_moves)) ponder_move = hash_move;
+      take_back();
+    }
+
+    take_back();
+  }
+
+  return ponder_move;
+}
+
+// =====================
+// Mate Search
+// =====================
+
+/*
+  df-pn (depth first proof number search) for forced mates of the side to
+  move, the attacker. both sides play all of their legal moves except the
+  attacker's last one, only a check can mate then. a position is proven
+  (mate) when the defender in check has no move and disproven when the
+  attacker has no move left, runs out of plies or stalemates the defender.
+
+  every position has a proof number (how many positions still have to be
+  proven to prove it) and a disproof number, both seen from the attacker.
+  mate_mid searches below the most proving child as long as the numbers stay
+  under the thresholds its parent gives it, the tree is kept in mate_table
+  instead of memory. the plies left to mate are part of the key, a position
+  is proven or disproven for that many plies: the first search allows
+  max_plies, then the found mate is cut by 2 plies until no shorter one exists.
+  the plies left also make the tree acyclic, repetitions need no handling
+  (a shortest mate never repeats a position)
+
+  mate_table entries (key ^ data like the main hash table), buckets of 2
+
+  proof number      0 .. 23
+  disproof number  24 .. 47
+  mate distance    48 .. 55   plies to mate of a proven position
+  work             56 .. 63   log2 of the nodes searched below it, the smaller one is replaced
+*/
+
+#define mate_infinity 0xffffff
+#define mate_max_plies 127
+
+#define pack_mate_data(proof, disproof, distance, work) \
+  ((uint64_t)(proof) | ((uint64_t)(disproof) << 24) | ((uint64_t)(distance) << 48) | ((uint64_t)(work) << 56))
+
+#define get_mate_proof(data) ((int)((data) & 0xffffff))
+#define get_mate_disproof(data) ((int)(((data) >> 24) & 0xffffff))
+#define get_mate_distance(data) ((int)(((data) >> 48) & 0xff))
+#define get_mate_work(data) ((int)(((data) >> 56) & 0xff))
+
+// proof number table, shared by the mate search threads
+tt* mate_table = NULL;
+
+// number of entries in mate table (even)
+uint64_t mate_entries = 0;
+
+// clear mate table
+void clear_mate_table() {
+  memset(mate_table, 0, mate_entries * sizeof(tt));
+}
+
+// (re)allocate mate table with the given size in MB
+void init_mate_table(const int mb) {
+  free(mate_table);
+
+  mate_entries = (((uint64_t)mb * 0x100000) / sizeof(tt)) & ~1ULL;
+  mate_table = (tt*)malloc(mate_entries * sizeof(tt));
+
+  if (mate_table == NULL) {
+    printf("    Couldn't allocate memory for mate table, trying %dMB...\n", mb / 2);
+    init_mate_table(mb / 2);
+    return;
+  }
+
+  clear_mate_table();
+}
+
+// side that mates (side to move at the root)
+int mate_attacker;
+
+// set when the root is solved or the search has to stop, ends every mate search thread
+atomic_int mate_stop;
+
+// nodes of all mate search threads, added up every time_check_interval nodes
+_Atomic uint64_t mate_nodes;
+
+// stop after that many nodes of all threads (0 -> no limit)
+uint64_t mate_node_limit;
+
+// key of the current position with plies_left plies to mate
+static inline uint64_t mate_key(const int plies_left) {
+  return hash_key ^ ((uint64_t)(plies_left + 1) * 0x9e3779b97f4a7c15ULL);
+}
+
+// numbers of a position, 1 / 1 if it isn't in the table
+static inline void read_mate_entry(const uint64_t key, int* proof, int* disproof, int* distance) {
+  tt* bucket = &mate_table[(key % mate_entries) & ~1ULL];
+
+  for (int i = 0; i < 2; ++i) {
+    uint64_t data = bucket[i].data;
+
+    if ((bucket[i].key ^ data) == key) {
+      *proof = get_mate_proof(data);
+      *disproof = get_mate_disproof(data);
+      *distance = get_mate_distance(data);
+      return;
+    }
+  }
+
+  *proof = 1;
+  *disproof = 1;
+  *distance = 0;
+}
+
+static inline void write_mate_entry(const uint64_t key, const int proof, const int disproof, const int distance, const int work) {
+  tt* bucket = &mate_table[(key % mate_entries) & ~1ULL];
+  tt* entry = &bucket[0];
+
+  // same position, else the one with less work below it
+  if ((bucket[1].key ^ bucket[1].data) == key) entry = &bucket[1];
+  else if ((bucket[0].key ^ bucket[0].data) != key && get_mate_work(bucket[1].data) < get_mate_work(bucket[0].data)) entry = &bucket[1];
+
+  // another thread solved it, the unfinished numbers of a stopped search don't replace that
+  if ((entry->key ^ entry->data) == key && proof && disproof &&
+      (get_mate_proof(entry->data) == 0 || get_mate_disproof(entry->data) == 0)) {
+    return;
+  }
+
+  uint64_t data = pack_mate_data(proof, disproof, distance, work);
+  entry->key = key ^ data;
+  entry->data = data;
+}
+
+// sum of proof or disproof numbers, infinity only if one of them is
+static inline int mate_sum(const int a, const int b) {
+  if (a >= mate_infinity || b >= mate_infinity) return mate_infinity;
+  return (a + b < mate_infinity - 1) ? a + b : mate_infinity - 1;
+}
+
+// legal moves of the mate search with plies_left plies to mate, the attacker's last move has to check
+static inline void generate_mate_moves(moves* mate_moves, const int plies_left) {
+  moves move_list[1];
+  move_generation(move_list);
+
+  int checks_only = (side == mate_attacker && plies_left <= 1);
+
+  mate_moves->count = 0;
+
+  for (int i = 0; i < move_list->count; ++i) {
+    copy_board();
+
+    // side was switched by make_move, it is the defender after an attacker move
+    if (make_move(move_list->moves[i], all_moves) && (!checks_only || in_check_side(side))) {
+      add_move(mate_moves, move_list->moves[i]);
+    }
+
+    take_back();
+  }
+}
+
+/*
+  search the current position until its proof number reaches proof_threshold
+  or its disproof number disproof_threshold (or it is solved), the final
+  numbers are returned and stored in the table. helper threads widen the
+  thresholds of their children and break ties in another order, so they
+  spread over different parts of the tree
+*/
+static void mate_mid(const int plies_left, const int proof_threshold, const int disproof_threshold, int* proof, int* disproof, int* distance) {
+  ++nodes;
+
+  if ((nodes & (time_check_interval - 1)) == 0) {
+    uint64_t total = atomic_fetch_add(&mate_nodes, time_check_interval) + time_check_interval;
+
+    if (thread_id == 0) check_limits();
+    if (search_stopped() || (mate_node_limit && total >= mate_node_limit)) atomic_store(&mate_stop, 1);
+  }
+
+  int attacking = (side == mate_attacker);
+  uint64_t key = mate_key(plies_left);
+
+  *distance = 0;
+
+  // out of plies before the attacker's next move
+  if (attacking && plies_left < 1) {
+    *proof = mate_infinity;
+    *disproof = 0;
+    return;
+  }
+
+  moves mate_moves[1];
+  generate_mate_moves(mate_moves, plies_left);
+
+  // no (checking) move left is a disproof, the defender without a move is mated or stalemated
+  if (mate_moves->count == 0 || plies_left < 1) {
+    int mated = !attacking && mate_moves->count == 0 && in_check_side(side);
+    *proof = mated ? 0 : mate_infinity;
+    *disproof = mated ? mate_infinity : 0;
+    write_mate_entry(key, *proof, *disproof, 0, 0);
+    return;
+  }
+
+  uint64_t child_keys[256];
+  int child_proof[256], child_disproof[256], child_distance[256];
+
+  for (int i = 0; i < mate_moves->count; ++i) {
+    copy_board();
+    make_move(mate_moves->moves[i], all_moves);
+    child_keys[i] = mate_key(plies_left - 1);
+    take_back();
+  }
+
+  uint64_t start_nodes = nodes;
+  int first = thread_id % mate_moves->count;
+
+  while (1) {
+    // or node (attacker): proof = min of the children, disproof = sum
+    // and node (defender): proof = sum of the children, disproof = min
+    int node_proof = attacking ? mate_infinity : 0;
+    int node_disproof = attacking ? 0 : mate_infinity;
+    int best = -1, best_value = mate_infinity + 1, second_value = mate_infinity;
+    int best_distance = attacking ? 255 : 0;
+
+    for (int j = 0; j < mate_moves->count; ++j) {
+      int i = (first + j) % mate_moves->count;
+
+      read_mate_entry(child_keys[i], &child_proof[i], &child_disproof[i], &child_distance[i]);
+
+      // the number the node is minimizing over its children
+      int value = attacking ? child_proof[i] : child_disproof[i];
+
+      if (attacking) {
+        node_proof = (child_proof[i] < node_proof) ? child_proof[i] : node_proof;
+        node_disproof = mate_sum(node_disproof, child_disproof[i]);
+        if (child_proof[i] == 0 && child_distance[i] < best_distance) best_distance = child_distance[i];
+      }
+      else {
+        node_proof = mate_sum(node_proof, child_proof[i]);
+        node_disproof = (child_disproof[i] < node_disproof) ? child_disproof[i] : node_disproof;
+        if (child_proof[i] == 0 && child_distance[i] > best_distance) best_distance = child_distance[i];
+      }
+
+      if (value < best_value) {
+        second_value = best_value;
+        best_value = value;
+        best = i;
+      }
+      else if (value < second_value) {
+        second_value = value;
+      }
+    }
+
+    *proof = node_proof;
+    *disproof = node_disproof;
+    *distance = (node_proof == 0) ? best_distance + 1 : 0;
+
+    if (node_proof >= proof_threshold || node_disproof >= disproof_threshold || atomic_load_explicit(&mate_stop, memory_order_relaxed)) break;
+
+    // the best child may grow up to the second best one (plus a margin on helper threads),
+    // its other number may take what the siblings leave of the node's threshold
+    if (second_value > mate_infinity - 1) second_value = mate_infinity - 1;
+    int limit = second_value + 1 + ((thread_id & 1) ? second_value / 4 : 0);
+    if (limit > mate_infinity) limit = mate_infinity;
+
+    int child_proof_threshold, child_disproof_threshold;
+
+    if (attacking) {
+      child_proof_threshold = (proof_threshold < limit) ? proof_threshold : limit;
+      child_disproof_threshold = (disproof_threshold >= mate_infinity) ? mate_infinity : disproof_threshold - node_disproof + child_disproof[best];
+    }
+    else {
+      child_disproof_threshold = (disproof_threshold < limit) ? disproof_threshold : limit;
+      child_proof_threshold = (proof_threshold >= mate_infinity) ? mate_infinity : proof_threshold - node_proof + child_proof[best];
+    }
+
+    copy_board();
+    make_move(mate_moves->moves[best], all_moves);
+    mate_mid(plies_left - 1, child_proof_threshold, child_disproof_threshold, &child_proof[best], &child_disproof[best], &child_distance[best]);
+    take_back();
+  }
+
+  // an unfinished search leaves its last numbers, they are still valid bounds
+  uint64_t work = nodes - start_nodes;
+  int log_work = 0;
+  while (work >>= 1) ++log_work;
+
+  write_mate_entry(key, *proof, *disproof, *distance, log_work);
+}
+
+// position the mate search threads start from
+position mate_root;
+
+// plies to mate the current run of the mate search threads is limited to
+int mate_plies;
+
+pthread_t mate_threads[max_threads];
+int mate_thread_ids[max_threads];
+
+// search the root until it is solved or the search stops, the first thread done stops the others
+void* mate_thread_main(void* arg) {
+  thread_id = *(int*)arg;
+  load_position(&mate_root);
+  nodes = 0;
+
+  int proof, disproof, distance;
+  mate_mid(mate_plies, mate_infinity, mate_infinity, &proof, &disproof, &distance);
+
+  atomic_fetch_add(&mate_nodes, nodes & (time_check_interval - 1));
+  atomic_store(&mate_stop, 1);
+
+  return NULL;
+}
+
+// prove a mate within plies_left plies from mate_root on threads threads:
+// 1 proven (plies to mate in *distance), 0 disproven, -1 stopped before it was solved
+int mate_prove(const int plies_left, const int threads, int* distance) {
+  mate_plies = plies_left;
+  atomic_store(&mate_stop, 0);
+
+  for (int i = 0; i < threads; ++i) {
+    mate_thread_ids[i] = i;
+    if (i) pthread_create(&mate_threads[i], NULL, mate_thread_main, &mate_thread_ids[i]);
+  }
+
+  mate_thread_main(&mate_thread_ids[0]);
+
+  for (int i = 1; i < threads; ++i) {
+    pthread_join(mate_threads[i], NULL);
+  }
+
+  load_position(&mate_root);
+
+  int proof, disproof;
+  read_mate_entry(mate_key(plies_left), &proof, &disproof, distance);
+
+  if (proof == 0) return 1;
+  if (disproof == 0) return 0;
+  return -1;
+}
+
+/*
+  shortest forced mate of the side to move in the current position within
+  max_plies plies, on threads threads: returns the plies to mate (odd, mate
+  in (plies + 1) / 2), 0 if there is none and -1 if the search stopped
+  before finding one. a search stopped while shortening returns the
+  shortest mate found so far. the mate line is written to pv
+*/
+int mate_search(const int max_plies, const int threads, moves* pv) {
+  if (mate_table == NULL) init_mate_table(64);
+
+  save_position(&mate_root);
+  mate_attacker = side;
+  atomic_store(&mate_nodes, 0);
+
+  // plies to mate and the limit of the search that proved it, the entries of the line are keyed by the limit
+  int found = 0, proven_plies = 0, result = 0;
+
+  for (int plies = max_plies; plies >= 1; plies = found - 2) {
+    int distance;
+    result = mate_prove(plies, threads, &distance);
+
+    if (result <= 0) break;
+
+    found = distance;
+    proven_plies = plies;
+  }
+
+  pv->count = 0;
+
+  if (found == 0) return (result < 0) ? -1 : 0;
+
+  // mate line out of the table: the quickest mate at the attacker's moves, the longest defence at the defender's
+  for (int plies = proven_plies; pv->count < found; --plies) {
+    moves mate_moves[1];
+    generate_mate_moves(mate_moves, plies);
+
+    int attacking = (side == mate_attacker);
+    int best_move = 0, best_distance = attacking ? 256 : -1;
+
+    for (int i = 0; i < mate_moves->count; ++i) {
+      copy_board();
+      make_move(mate_moves->moves[i], all_moves);
+
+      int proof, disproof, distance;
+      read_mate_entry(mate_key(plies - 1), &proof, &disproof, &distance);
+
+      if (proof == 0 && (attacking ? distance < best_distance : distance > best_distance)) {
+        best_distance = distance;
+        best_move = mate_moves->moves[i];
+      }
+
+      take_back();
+    }
+
+    // line cut short by a replaced entry
+    if (best_move == 0) break;
+
+    add_move(pv, best_move);
+    make_move(best_move, all_moves);
+  }
+
+  load_position(&mate_root);
+
+  return found;
+}
+
+/*
+  main mate <input.epd> [moves N] [nodes N] [threads N] [hash MB]
+
+  looks for the shortest forced mate in N moves (default 20) of the side to
+  move in every position of the input (FEN or EPD, one per line), stopping
+  a position after the given number of nodes (default 10000000, 0 -> no
+  limit). one line per position:
+
+    line <tab> mate <moves> <tab> bestmove <tab> nodes <tab> time ms <tab> input line
+    line <tab> none <tab> <tab> nodes <tab> time ms <tab> input line        no mate in N moves
+    line <tab> unknown <tab> <tab> nodes <tab> time ms <tab> input line     out of nodes
+    line <tab> error <tab> message <tab> <tab> <tab> input line
+*/
+
+int mate_main(const int argc, char* argv[]) {
+  if (argc < 1) {
+    printf("usage: mate <input> [moves N] [nodes N] [threads N] [hash MB]\n");
+    return 1;
+  }
+
+  int mate_moves = 20, threads = 1, hash_mb = 64;
+  uint64_t node_limit = 10000000;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "moves") == 0) mate_moves = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "nodes") == 0) node_limit = strtoull(argv[i + 1], NULL, 10);
+    else if (strcmp(argv[i], "threads") == 0) threads = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "hash") == 0) hash_mb = atoi(argv[i + 1]);
+  }
+
+  if (mate_moves < 1) mate_moves = 1;
+  if (mate_moves * 2 - 1 > mate_max_plies) mate_moves = (mate_max_plies + 1) / 2;
+  if (threads < 1) threads = 1;
+  if (threads > max_threads) threads = max_threads;
+  if (hash_mb < 1) hash_mb = 1;
+
+  FILE* input = fopen(argv[0], "r");
+
+  if (input == NULL) {
+    printf("can't open %s\n", argv[0]);
+    return 1;
+  }
+
+  init_mate_table(hash_mb);
+
+  limits = (search_limits){ 0 };
+  stop_time = 0;
+  soft_time_limit = 0;
+  atomic_store(&stop_search, 0);
+  mate_node_limit = node_limit;
+
+  char line[1024];
+  uint64_t line_number = 0, positions = 0, mates = 0, total_nodes = 0;
+  uint64_t start = get_time_ms();
+
+  while (fgets(line, sizeof(line), input)) {
+    ++line_number;
+    line[strcspn(line, "\r\n")] = '\0';
+
+    const char* first = line;
+    while (*first == ' ' || *first == '\t') ++first;
+    if (*first == '\0' || *first == '#') continue;
+
+    const char* error = NULL;
+
+    parse_FEN_checked(line, line + strlen(line), &error);
+
+    if (error) {
+      printf("%llu\terror\t%s\t\t\t%s\n", (unsigned long long)line_number, error, line);
+      continue;
+    }
+
+    moves pv;
+    uint64_t position_start = get_time_ms();
+    int plies = mate_search(mate_moves * 2 - 1, threads, &pv);
+    uint64_t position_nodes = atomic_load(&mate_nodes);
+
+    ++positions;
+    total_nodes += position_nodes;
+
+    char move_string[6];
+
+    if (plies > 0) {
+      ++mates;
+      printf("%llu\tmate %d\t%s", (unsigned long long)line_number, (plies + 1) / 2, pv.count ? move_to_string(pv.moves[0], move_string) : "");
+    }
+    else {
+      printf("%llu\t%s\t", (unsigned long long)line_number, plies ? "unknown" : "none");
+    }
+
+    printf("\t%llu\t%llu\t%s\n", (unsigned long long)position_nodes, (unsigned long long)(get_time_ms() - position_start), line);
+    fflush(stdout);
+  }
+
+  fclose(input);
+
+  uint64_t time = get_time_ms() - start;
+
+  printf("positions %llu mates %llu nodes %llu time %llu ms nps %llu\n",
+    (unsigned long long)positions, (unsigned long long)mates, (unsigned long long)total_nodes,
+    (unsigned long long)time, (unsigned long long)(total_nodes * 1000 / (time + 1)));
+
+  return 0;
+}
+
+// =====================
+// UCI
+// =====================
+
+// search thread started by go
+pthread_t search_thread;
+int search_running = 0;
+
+// parse move string (e.g. e7e8q) into a legal move of the current position, 0 if there is none
+int parse_move(const char* move_string) {
+  // truncated or malformed square names
+  if (strlen(move_string) < 4) return 0;
+  if (move_string[0] < 'a' || move_string[0] > 'h' || move_string[1] < '1' || move_string[1] > '8') return 0;
+  if (move_string[2] < 'a' || move_string[2] > 'h' || move_string[3] < '1' || move_string[3] > '8') return 0;
+
+  moves move_list[1];
+  move_generation(move_list);
+
+  int source_square = (move_string[0] - 'a') + (move_string[1] - '1') * 8;
+  int destination_square = (move_string[2] - 'a') + (move_string[3] - '1') * 8;
+
+  for (int i = 0; i < move_list->count; ++i) {
+    int move = move_list->moves[i];
+
+    if (get_move_source(move) != source_square || get_move_destination(move) != destination_square) continue;
+
+    int promoted_piece = get_move_promoted(move);
+
+    if (promoted_piece && promoted_pieces[promoted_piece] != move_string[4]) continue;
+
+    return move;
+  }
+
+  return 0;
+}
+
+/*
+  position startpos
+  position startpos moves e2e4 e7e5
+  position fen r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1
+  position fen r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1 moves e2a6 e8g8
+*/
+void parse_position(char* command) {
+  // skip "position "
+  command += 9;
+
+  char* current = command;
+
+  if (strncmp(command, "startpos", 8) == 0) {
+    parse_FEN(start_position);
+  }
+  else {
+    current = strstr(command, "fen");
+
+    if (current == NULL) {
+      parse_FEN(start_position);
+    }
+    else {
+      current += 4;
+      parse_FEN(current);
+    }
+  }
+
+  current = strstr(command, "moves");
+
+  if (current != NULL) {
+    current += 6;
+
+    while (*current) {
+      int move = parse_move(current);
+
+      // illegal move, stop replaying
+      if (move == 0) break;
+
+      make_move(move, all_moves);
+
+      // skip to next move
+      while (*current && *current != ' ') ++current;
+      while (*current == ' ') ++current;
+    }
+  }
+}
+
+// wait for a running search thread to finish
+void join_search() {
+  if (search_running) {
+    pthread_join(search_thread, NULL);
+    search_running = 0;
+  }
+}
+
+// stop and wait for a running search
+void stop_running_search() {
+  atomic_store(&stop_search, 1);
+  atomic_store(&pondering, 0);
+  join_search();
+}
+
+// go mate: proof number search of root_position on thread_count threads, returns
+// the mate line (empty if there is no mate in limits.mate moves or it stopped first)
+void go_mate(moves* pv) {
+  thread_id = 0;
+  load_position(&root_position);
+
+  int max_plies = limits.mate * 2 - 1;
+  if (max_plies > mate_max_plies) max_plies = mate_max_plies;
+
+  mate_node_limit = limits.nodes;
+
+  int plies = mate_search(max_plies, thread_count, pv);
+  if (plies <= 0 || pv->count == 0) return;
+
+  uint64_t total_nodes = atomic_load(&mate_nodes);
+  uint64_t time = get_time_ms() - start_time;
+
+  printf("info depth %d score mate %d nodes %llu nps %llu time %llu pv", plies, (plies + 1) / 2,
+    (unsigned long long)total_nodes, (unsigned long long)(total_nodes * 1000 / (time ? time : 1)), (unsigned long long)time);
+
+  for (int i = 0; i < pv->count; ++i) {
+    printf(" ");
+    print_move(pv->moves[i]);
+  }
+
+  printf("\n");
+
+  // bestmove can't be sent in infinite or ponder mode before stop or ponderhit
+  while (!search_stopped() && (limits.infinite || atomic_load(&pondering))) {
+    sleep_ms(1);
+  }
+}
+
+// search thread entry, prints bestmove when done
+void* search_thread_main(void* arg) {
+  int best_move = 0;
+  moves mate_pv = { .count = 0 };
+
+  // book moves only when the gui waits for a move now
+  if (own_book && !limits.infinite && !limits.ponder && limits.search_moves.count == 0) {
+    load_position(&root_position);
+    best_move = book_move();
+  }
+
+  // the normal search takes over when there is no mate
+  if (best_move == 0 && limits.mate) {
+    go_mate(&mate_pv);
+    if (mate_pv.count) best_move = mate_pv.moves[0];
+  }
+
+  if (best_move == 0) best_move = parallel_search();
+
+  int ponder_move = (mate_pv.count > 1) ? mate_pv.moves[1] : get_ponder_move(best_move);
+
+  printf("bestmove ");
+  print_move(best_move);
+
+  if (ponder_move) {
+    printf(" ponder ");
+    print_move(ponder_move);
+  }
+
+  printf("\n");
+
+  return NULL;
+}
+
+// value of integer parameter name in command, 0 if not present
+int parse_go_value(const char* command, const char* name) {
+  const char* current = strstr(command, name);
+  return current ? atoi(current + strlen(name)) : 0;
+}
+
+/*
+  go depth 6
+  go nodes 100000
+  go movetime 1000
+  go wtime 60000 btime 60000 winc 1000 binc 1000 movestogo 40
+  go infinite
+  go depth 8 searchmoves e2e4 d2d4
+  go ponder wtime 60000 btime 60000
+  go mate 5
+*/
+void parse_go(char* command) {
+  stop_running_search();
+
+  limits = (search_limits){ 0 };
+  limits.depth = parse_go_value(command, "depth ");
+  limits.nodes = (uint64_t)strtoull(strstr(command, "nodes ") ? strstr(command, "nodes ") + 6 : "0", NULL, 10);
+  limits.movetime = parse_go_value(command, "movetime ");
+  limits.wtime = parse_go_value(command, "wtime ");
+  limits.btime = parse_go_value(command, "btime ");
+  limits.winc = parse_go_value(command, "winc ");
+  limits.binc = parse_go_value(command, "binc ");
+  limits.movestogo = parse_go_value(command, "movestogo ");
+  limits.infinite = strstr(command, "infinite") != NULL;
+  limits.ponder = strstr(command, "ponder") != NULL;
+  limits.mate = parse_go_value(command, "mate ");
+
+  char* current = strstr(command, "searchmoves ");
+
+  if (current != NULL) {
+    current += 12;
+
+    int move;
+
+    // moves up to the next parameter
+    while (*current && (move = parse_move(current))) {
+      add_move(&limits.search_moves, move);
+
+      while (*current && *current != ' ') ++current;
+      while (*current == ' ') ++current;
+    }
+  }
+
+  if (limits.depth <= 0 || limits.depth > max_ply - 1) limits.depth = max_ply - 1;
+
+  start_time = get_time_ms();
+  init_time_limits();
+
+  atomic_store(&stop_search, 0);
+  atomic_store(&pondering, limits.ponder);
+
+  save_position(&root_position);
+
+  pthread_create(&search_thread, NULL, search_thread_main, NULL);
+  search_running = 1;
+}
+
+// set check option from "true" / "false"
+void set_check_option(int* option, const char* value) {
+  *option = strncmp(value, "true", 4) == 0;
+}
+
+// setoption name Hash value 128
+void parse_setoption(char* command) {
+  char* name = strstr(command, "name ");
+  char* value = strstr(command, "value ");
+
+  if (name == NULL || value == NULL) return;
+
+  name += 5;
+  value += 6;
+
+  // options can't change under a running search
+  stop_running_search();
+
+  if (strncmp(name, "Hash", 4) == 0) {
+    int mb = atoi(value);
+    if (mb < 1) mb = 1;
+    init_hash_table(mb);
+  }
+  else if (strncmp(name, "MultiPV", 7) == 0) {
+    multi_pv = atoi(value);
+    if (multi_pv < 1) multi_pv = 1;
+    if (multi_pv > max_multi_pv) multi_pv = max_multi_pv;
+  }
+  else if (strncmp(name, "Threads", 7) == 0) {
+    thread_count = atoi(value);
+    if (thread_count < 1) thread_count = 1;
+    if (thread_count > max_threads) thread_count = max_threads;
+  }
+  else if (strncmp(name, "Move Overhead", 13) == 0) {
+    move_overhead = atoi(value);
+    if (move_overhead < 0) move_overhead = 0;
+  }
+  else if (strncmp(name, "NullMove", 8) == 0) set_check_option(&null_move_pruning, value);
+  else if (strncmp(name, "LateMoveReductions", 18) == 0) set_check_option(&late_move_reductions, value);
+  else if (strncmp(name, "ReverseFutility", 15) == 0) set_check_option(&reverse_futility_pruning, value);
+  else if (strncmp(name, "Futility", 8) == 0) set_check_option(&futility_pruning, value);
+  else if (strncmp(name, "LateMovePruning", 15) == 0) set_check_option(&late_move_pruning, value);
+  else if (strncmp(name, "Razoring", 8) == 0) set_check_option(&razoring, value);
+  else if (strncmp(name, "OwnBook", 7) == 0) set_check_option(&own_book, value);
+  else if (strncmp(name, "BookBestMove", 12) == 0) set_check_option(&book_best_move, value);
+  else if (strncmp(name, "BookFile", 8) == 0) {
+    value[strcspn(value, "\r\n")] = '\0';
+    open_book(value);
+  }
+  else if (strncmp(name, "SyzygyPath", 10) == 0) {
+    // path runs to the end of the line
+    value[strcspn(value, "\r\n")] = '\0';
+    init_tablebases(value);
+  }
+}
+
+void print_uci_id() {
+  printf("id name S.A.R.A\n");
+  printf("id author Vikas Goudar\n");
+  printf("option name Hash type spin default 64 min 1 max 16384\n");
+  printf("option name Threads type spin default 1 min 1 max %d\n", max_threads);
+  printf("option name MultiPV type spin default 1 min 1 max %d\n", max_multi_pv);
+  printf("option name Ponder type check default false\n");
+  printf("option name Move Overhead type spin default 30 min 0 max 5000\n");
+  printf("option name NullMove type check default true\n");
+  printf("option name LateMoveReductions type check default true\n");
+  printf("option name ReverseFutility type check default true\n");
+  printf("option name Futility type check default true\n");
+  printf("option name LateMovePruning type check default true\n");
+  printf("option name Razoring type check default true\n");
+  printf("option name SyzygyPath type string default <empty>\n");
+  printf("option name OwnBook type check default false\n");
+  printf("option name BookFile type string default <empty>\n");
+  printf("option name BookBestMove type check default false\n");
+  printf("uciok\n");
+}
+
+/*
+  the uci thread only reads commands, searches run on their own thread so
+  stop and ponderhit are seen as soon as they arrive instead of the search
+  polling stdin
+*/
+void uci_loop() {
+  // no buffering so the gui sees every line immediately
+  setbuf(stdin, NULL);
+  setbuf(stdout, NULL);
+
+  char input[20000];
+
+  parse_FEN(start_position);
+
+  while (fgets(input, sizeof(input), stdin)) {
+    // skip empty lines
+    if (input[0] == '\n') continue;
+
+    if (strncmp(input, "isready", 7) == 0) {
+      printf("readyok\n");
+    }
+    else if (strncmp(input, "position", 8) == 0) {
+      parse_position(input);
+    }
+    else if (strncmp(input, "ucinewgame", 10) == 0) {
+      stop_running_search();
+      parse_FEN(start_position);
+      clear_hash_table();
+      clear_saved_move_history();
+    }
+    else if (strncmp(input, "go", 2) == 0) {
+      parse_go(input);
+    }
+    else if (strncmp(input, "stop", 4) == 0) {
+      stop_running_search();
+    }
+    else if (strncmp(input, "ponderhit", 9) == 0) {
+      // time limit counts from now on
+      start_time = get_time_ms();
+      init_time_limits();
+      atomic_store(&pondering, 0);
+    }
+    else if (strncmp(input, "setoption", 9) == 0) {
+      parse_setoption(input);
+    }
+    else if (strncmp(input, "uci", 3) == 0) {
+      print_uci_id();
+    }
+    else if (strncmp(input, "quit", 4) == 0) {
+      stop_running_search();
+      break;
+    }
+
+    // debug commands
+    else if (strncmp(input, "d", 1) == 0) {
+      print_board();
+    }
+    else if (strncmp(input, "book", 4) == 0) {
+      print_book_moves();
+    }
+    else if (strncmp(input, "perft", 5) == 0) {
+      stop_running_search();
+      perft_test(atoi(input + 6));
+    }
+    else if (strncmp(input, "report", 6) == 0) {
+      stop_running_search();
+      position current;
+      save_position(&current);
+      selective_search_report(atoi(input + 7));
+      load_position(&current);
+    }
+  }
+
+  stop_running_search();
+}
+
+// =====================
+// Batch Analysis
+// =====================
+
+/*
+  main batch <input.epd> <output> [depth N] [nodes N] [threads N] [hash MB]
+
+  the input (FEN or EPD, one position per line) is mmapped and split into
+  line aligned chunks that worker threads claim one at a time. every worker
+  parses straight out of the mapping into its own thread local board and
+  runs an independent fixed depth / fixed nodes search. every worker has
+  its own hash table (hash MB each, 16 by default) that is cleared together
+  with the move history before each position, so a position gets the same
+  result whatever was analysed before it and however many threads run.
+  results are written in input order as soon as all earlier chunks are done:
+
+    line <tab> bestmove <tab> score <tab> depth <tab> nodes <tab> input line
+    line <tab> error <tab> message <tab> <tab> <tab> input line
+*/
+
+#define batch_chunks_per_thread 16
+
+typedef struct {
+  const char* begin;
+  const char* end;
+  uint64_t first_line;
+  uint64_t line_count;
+  char* output;
+  size_t output_length;
+  size_t output_capacity;
+  int done;
+} batch_chunk;
+
+batch_chunk* batch_chunk_list;
+int batch_chunk_count;
+atomic_int batch_next_chunk;
+
+FILE* batch_output;
+int batch_hash_mb = 16;
+pthread_mutex_t batch_output_mutex = PTHREAD_MUTEX_INITIALIZER;
+int batch_next_to_write;
+
+_Atomic uint64_t batch_positions;
+_Atomic uint64_t batch_errors;
+_Atomic uint64_t batch_nodes;
+
+// append a formatted line to the chunk's result buffer
+void batch_append(batch_chunk* chunk, const char* format, ...) {
+  va_list args;
+
+  while (1) {
+    size_t space = chunk->output_capacity - chunk->output_length;
+
+    va_start(args, format);
+    int length = vsnprintf(chunk->output + chunk->output_length, space, format, args);
+    va_end(args);
+
+    if ((size_t)length < space) {
+      chunk->output_length += length;
+      return;
+    }
+
+    chunk->output_capacity = 2 * chunk->output_capacity + length;
+    chunk->output = (char*)realloc(chunk->output, chunk->output_capacity);
+  }
+}
+
+// mark chunk done and write out every finished chunk that is next in input order
+void batch_flush(batch_chunk* chunk) {
+  pthread_mutex_lock(&batch_output_mutex);
+
+  chunk->done = 1;
+
+  while (batch_next_to_write < batch_chunk_count && batch_chunk_list[batch_next_to_write].done) {
+    batch_chunk* next = &batch_chunk_list[batch_next_to_write++];
+
+    fwrite(next->output, 1, next->output_length, batch_output);
+
+    free(next->output);
+    next->output = NULL;
+  }
+
+  pthread_mutex_unlock(&batch_output_mutex);
+}
+
+// count the lines of chunks claimed one at a time
+void* batch_count_main(void* arg) {
+  int index;
+
+  while ((index = atomic_fetch_add(&batch_next_chunk, 1)) < batch_chunk_count) {
+    batch_chunk* chunk = &batch_chunk_list[index];
+    const char* current = chunk->begin;
+
+    while (current < chunk->end) {
+      const char* newline = memchr(current, '\n', chunk->end - current);
+      ++chunk->line_count;
+      current = newline ? newline + 1 : chunk->end;
+    }
+  }
+
+  return NULL;
+}
+
+// analyse the positions of chunks claimed one at a time
+void* batch_worker_main(void* arg) {
+  atomic_int own_stop;
+
+  // independent searches: check own limits, stop only this thread
+  thread_id = 0;
+  stop_flag = &own_stop;
+
+  own_hash_entries = ((uint64_t)batch_hash_mb * 0x100000) / sizeof(tt);
+  own_hash_table = (tt*)malloc(own_hash_entries * sizeof(tt));
+
+  int index;
+  char move_string[6];
+
+  while ((index = atomic_fetch_add(&batch_next_chunk, 1)) < batch_chunk_count) {
+    batch_chunk* chunk = &batch_chunk_list[index];
+    const char* line = chunk->begin;
+    uint64_t line_number = chunk->first_line;
+
+    chunk->output_capacity = 4096;
+    chunk->output = (char*)malloc(chunk->output_capacity);
+    chunk->output_length = 0;
+
+    for (; line < chunk->end; ++line_number) {
+      const char* newline = memchr(line, '\n', chunk->end - line);
+      const char* line_end = newline ? newline : chunk->end;
+      const char* next_line = newline ? newline + 1 : chunk->end;
+
+      // keep windows line endings out of the echoed line
+      const char* text_end = line_end;
+      if (text_end > line && text_end[-1] == '\r') --text_end;
+
+      int length = (int)(text_end - line);
+
+      // skip empty and comment lines
+      const char* first = line;
+      while (first < text_end && (*first == ' ' || *first == '\t')) ++first;
+      if (first == text_end || *first == '#') {
+        line = next_line;
+        continue;
+      }
+
+      const char* error = NULL;
+
+      parse_FEN_checked(line, text_end, &error);
+
+      if (error) {
+        batch_append(chunk, "%llu\terror\t%s\t\t\t%.*s\n", (unsigned long long)line_number, error, length, line);
+        atomic_fetch_add(&batch_errors, 1);
+        line = next_line;
+        continue;
+      }
+
+      // no state from earlier positions
+      memset(own_hash_table, 0, own_hash_entries * sizeof(tt));
+      clear_move_history();
+
+      atomic_store(stop_flag, 0);
+      int best_move = search_position(limits.depth);
+
+      batch_append(chunk, "%llu\t%s\t%d\t%d\t%llu\t%.*s\n", (unsigned long long)line_number, move_to_string(best_move, move_string), best_score, completed_depth, (unsigned long long)nodes, length, line);
+
+      atomic_fetch_add(&batch_positions, 1);
+      atomic_fetch_add(&batch_nodes, nodes);
+
+      line = next_line;
+    }
+
+    batch_flush(chunk);
+  }
+
+  free(own_hash_table);
+  own_hash_table = NULL;
+
+  return NULL;
+}
+
+int batch_main(const int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("usage: batch <input> <output> [depth N] [nodes N] [threads N] [hash MB]\n");
+    return 1;
+  }
+
+  int depth = 0, threads = 1;
+  uint64_t node_limit = 0;
+
+  for (int i = 2; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "depth") == 0) depth = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "nodes") == 0) node_limit = strtoull(argv[i + 1], NULL, 10);
+    else if (strcmp(argv[i], "threads") == 0) threads = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "hash") == 0 && atoi(argv[i + 1]) > 0) batch_hash_mb = atoi(argv[i + 1]);
+  }
+
+  if (depth <= 0 && node_limit == 0) depth = 8;
+  if (depth <= 0 || depth > max_ply - 1) depth = max_ply - 1;
+  if (threads < 1) threads = 1;
+  if (threads > max_threads) threads = max_threads;
+
+  int fd = open(argv[0], O_RDONLY);
+  struct stat file_stat;
+
+  if (fd < 0 || fstat(fd, &file_stat)) {
+    printf("can't open %s\n", argv[0]);
+    return 1;
+  }
+
+  size_t size = file_stat.st_size;
+  const char* data = (size > 0) ? (const char*)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : NULL;
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    printf("can't map %s\n", argv[0]);
+    return 1;
+  }
+
+  // read once front to back
+  if (data) madvise((void*)data, size, MADV_SEQUENTIAL);
+
+  batch_output = fopen(argv[1], "w");
+  if (batch_output == NULL) {
+    printf("can't create %s\n", argv[1]);
+    return 1;
+  }
+
+  // line aligned chunks
+  int max_chunks = threads * batch_chunks_per_thread;
+  batch_chunk_list = (batch_chunk*)calloc(max_chunks, sizeof(batch_chunk));
+  batch_chunk_count = 0;
+
+  const char* current = data;
+  const char* end = data + size;
+
+  while (data && current < end) {
+    const char* chunk_end = current + (size / max_chunks) + 1;
+
+    if (chunk_end >= end || batch_chunk_count == max_chunks - 1) {
+      chunk_end = end;
+    }
+    else {
+      const char* newline = memchr(chunk_end, '\n', end - chunk_end);
+      chunk_end = newline ? newline + 1 : end;
+    }
+
+    batch_chunk_list[batch_chunk_count].begin = current;
+    batch_chunk_list[batch_chunk_count].end = chunk_end;
+    ++batch_chunk_count;
+
+    current = chunk_end;
+  }
+
+  pthread_t workers[max_threads];
+  uint64_t start = get_time_ms();
+
+  // first pass: lines per chunk, so every chunk knows its first line number
+  atomic_store(&batch_next_chunk, 0);
+  for (int i = 0; i < threads; ++i) pthread_create(&workers[i], NULL, batch_count_main, NULL);
+  for (int i = 0; i < threads; ++i) pthread_join(workers[i], NULL);
+
+  uint64_t line_number = 1;
+  for (int i = 0; i < batch_chunk_count; ++i) {
+    batch_chunk_list[i].first_line = line_number;
+    line_number += batch_chunk_list[i].line_count;
+  }
+
+  // second pass: analysis
+  limits = (search_limits){ .depth = depth, .nodes = node_limit };
+  stop_time = 0;
+  soft_time_limit = 0;
+  print_search_info = 0;
+  batch_next_to_write = 0;
+
+  atomic_store(&batch_next_chunk, 0);
+  for (int i = 0; i < threads; ++i) pthread_create(&workers[i], NULL, batch_worker_main, NULL);
+  for (int i = 0; i < threads; ++i) pthread_join(workers[i], NULL);
+
+  fclose(batch_output);
+
+  uint64_t time = get_time_ms() - start;
+  uint64_t positions = atomic_load(&batch_positions);
+
+  printf("positions %llu errors %llu nodes %llu time %llu ms positions/s %.1f\n",
+    (unsigned long long)positions, (unsigned long long)atomic_load(&batch_errors), (unsigned long long)atomic_load(&batch_nodes),
+    (unsigned long long)time, positions * 1000.0 / (time + 1));
+
+  if (data) munmap((void*)data, size);
+  free(batch_chunk_list);
+
+  return 0;
+}
+
+// =====================
+// Self Play
+// =====================
+
+/*
+  main selfplay <output> [games N] [nodes N] [threads N] [random N] [seed N]
+
+  every thread plays whole games against itself at a fixed node count,
+  starting with random legal moves so the games differ, and records
+  (position, score, result) for each quiet position that isn't in check.
+  positions are packed into 32 bytes:
+
+    occupancy   8 bytes   piece_color_mask[white_black]
+    pieces     16 bytes   4 bit piece codes (P .. k) in square order of the occupied squares
+    score       2 bytes   search score from the side to move's point of view
+    flags       1 byte    side to move (bit 0), castle rights (bits 1 - 4)
+    enpassant   1 byte    en passant square, 64 if none
+    result      1 byte    game result for white: 0 loss, 1 draw, 2 win
+    halfmove    1 byte    moves since the last capture or pawn move
+    ply         2 bytes   game ply
+
+  finished games go into fixed size buffers from a preallocated pool, full
+  buffers are written by a separate writer thread, so the game threads
+  neither allocate nor touch the disk
+*/
+
+typedef struct {
+  uint64_t occupancy;
+  uint8_t pieces[16];
+  int16_t score;
+  uint8_t flags;
+  uint8_t enpassant;
+  uint8_t result;
+  uint8_t halfmove;
+  uint16_t ply;
+} packed_position;
+
+#define selfplay_buffer_positions 8192
+#define selfplay_max_game_plies 400
+
+typedef struct {
+  packed_position positions[selfplay_buffer_positions];
+  int count;
+} selfplay_buffer;
+
+// buffer pool: free buffers and full buffers waiting for the writer
+selfplay_buffer** selfplay_free_buffers;
+selfplay_buffer** selfplay_full_buffers;
+int selfplay_free_count;
+int selfplay_full_count;
+int selfplay_buffer_count;
+int selfplay_writers_done;
+
+pthread_mutex_t selfplay_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t selfplay_buffer_freed = PTHREAD_COND_INITIALIZER;
+pthread_cond_t selfplay_buffer_filled = PTHREAD_COND_INITIALIZER;
+
+FILE* selfplay_output;
+
+atomic_int selfplay_games_left;
+_Atomic uint64_t selfplay_games;
+_Atomic uint64_t selfplay_positions;
+int selfplay_random_plies = 8;
+uint64_t selfplay_seed = 1;
+
+// pack the current position
+void pack_position(packed_position* packed, const int score, const int halfmove, const int game_ply) {
+  memset(packed, 0, sizeof(packed_position));
+
+  packed->occupancy = piece_color_mask[white_black];
+
+  uint64_t occupancy = piece_color_mask[white_black];
+  int index = 0;
+
+  while (occupancy) {
+    int pos1D = LSB_index(occupancy);
+    packed->pieces[index / 2] |= piece_on(pos1D) << (4 * (index & 1));
+    ++index;
+    occupancy &= occupancy - 1;
+  }
+
+  packed->score = (int16_t)score;
+  packed->flags = side | (castle << 1);
+  packed->enpassant = (enpassant_pos1D == out_of_bounds_pos1D) ? 64 : enpassant_pos1D;
+  packed->halfmove = (halfmove < 255) ? halfmove : 255;
+  packed->ply = game_ply;
+}
+
+// hand a full buffer to the writer and take an empty one
+selfplay_buffer* selfplay_swap_buffer(selfplay_buffer* full) {
+  pthread_mutex_lock(&selfplay_mutex);
+
+  if (full) {
+    selfplay_full_buffers[selfplay_full_count++] = full;
+    pthread_cond_signal(&selfplay_buffer_filled);
+  }
+
+  while (selfplay_free_count == 0) pthread_cond_wait(&selfplay_buffer_freed, &selfplay_mutex);
+
+  selfplay_buffer* empty = selfplay_free_buffers[--selfplay_free_count];
+
+  pthread_mutex_unlock(&selfplay_mutex);
+
+  empty->count = 0;
+  return empty;
+}
+
+// write full buffers until all game threads are done
+void* selfplay_writer_main(void* arg) {
+  pthread_mutex_lock(&selfplay_mutex);
+
+  while (1) {
+    while (selfplay_full_count == 0 && !selfplay_writers_done) pthread_cond_wait(&selfplay_buffer_filled, &selfplay_mutex);
+
+    if (selfplay_full_count == 0) break;
+
+    selfplay_buffer* buffer = selfplay_full_buffers[--selfplay_full_count];
+
+    // write without holding the lock
+    pthread_mutex_unlock(&selfplay_mutex);
+    fwrite(buffer->positions, sizeof(packed_position), buffer->count, selfplay_output);
+    pthread_mutex_lock(&selfplay_mutex);
+
+    selfplay_free_buffers[selfplay_free_count++] = buffer;
+    pthread_cond_signal(&selfplay_buffer_freed);
+  }
+
+  pthread_mutex_unlock(&selfplay_mutex);
+
+  return NULL;
+}
+
+// kings only or a single minor piece left
+static inline int insufficient_material() {
+  if (piece_bitboards[P] | piece_bitboards[p] | piece_bitboards[R] | piece_bitboards[r] | piece_bitboards[Q] | piece_bitboards[q]) return 0;
+
+  return popcount(piece_bitboards[N] | piece_bitboards[n] | piece_bitboards[B] | piece_bitboards[b]) <= 1;
+}
+
+// legal moves of the current position, returns their count
+int generate_legal_moves(moves* legal_list) {
+  moves move_list[1];
+  move_generation(move_list);
+
+  legal_list->count = 0;
+
+  for (int i = 0; i < move_list->count; ++i) {
+    copy_board();
+    if (!make_move(move_list->moves[i], all_moves)) continue;
+    take_back();
+    add_move(legal_list, move_list->moves[i]);
+  }
+
+  return legal_list->count;
+}
+
+void* selfplay_worker_main(void* arg) {
+  atomic_int own_stop;
+
+  // independent searches: check own limits, stop only this thread
+  thread_id = 0;
+  stop_flag = &own_stop;
+
+  uint64_t random_state = selfplay_seed * 0x9e3779b97f4a7c15ULL + (uint64_t)(intptr_t)arg + 1;
+
+  // positions of the game in progress
+  packed_position game_positions[selfplay_max_game_plies];
+
+  selfplay_buffer* buffer = selfplay_swap_buffer(NULL);
+
+  while (atomic_fetch_sub(&selfplay_games_left, 1) > 0) {
+    parse_FEN(start_position);
+
+    int game_ply = 0, recorded = 0;
+    int result = 1;
+    moves legal_list[1];
+
+    while (1) {
+      if (generate_legal_moves(legal_list) == 0) {
+        // checkmate or stalemate
+        if (is_square_attacked(LSB_index(piece_bitboards[(side == white) ? K : k]), side ^ 1)) result = (side == white) ? 0 : 2;
+        break;
+      }
+
+      // fifty move rule, insufficient material, too long
+      if (halfmove_clock >= 100 || insufficient_material() || game_ply >= selfplay_max_game_plies) break;
+
+      // threefold repetition
+      if (count_repetitions(2) >= 2) break;
+
+      int move;
+
+      if (game_ply < selfplay_random_plies) {
+        // xorshift64
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 7;
+        random_state ^= random_state << 17;
+
+        move = legal_list->moves[random_state % legal_list->count];
+      }
+      else {
+        atomic_store(stop_flag, 0);
+        move = search_position(limits.depth);
+
+        // keep quiet positions that aren't in check, their score is the static picture
+        int quiet = !get_move_capture(move) && !get_move_promoted(move);
+        int in_check = is_square_attacked(LSB_index(piece_bitboards[(side == white) ? K : k]), side ^ 1);
+
+        if (quiet && !in_check && abs(best_score) < mate_score) {
+          pack_position(&game_positions[recorded++], best_score, halfmove_clock, game_ply);
+        }
+      }
+
+      make_move(move, all_moves);
+      ++game_ply;
+    }
+
+    // result is known now, move the game to the write buffer
+    for (int i = 0; i < recorded; ++i) {
+      if (buffer->count == selfplay_buffer_positions) buffer = selfplay_swap_buffer(buffer);
+
+      game_positions[i].result = result;
+      buffer->positions[buffer->count++] = game_positions[i];
+    }
+
+    atomic_fetch_add(&selfplay_games, 1);
+    atomic_fetch_add(&selfplay_positions, recorded);
+  }
+
+  // hand over the last partial buffer
+  pthread_mutex_lock(&selfplay_mutex);
+  selfplay_full_buffers[selfplay_full_count++] = buffer;
+  pthread_cond_signal(&selfplay_buffer_filled);
+  pthread_mutex_unlock(&selfplay_mutex);
+
+  return NULL;
+}
+
+int selfplay_main(const int argc, char* argv[]) {
+  if (argc < 1) {
+    printf("usage: selfplay <output> [games N] [nodes N] [threads N] [random N] [seed N]\n");
+    return 1;
+  }
+
+  int games = 100, threads = 1;
+  uint64_t node_limit = 5000;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "games") == 0) games = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "nodes") == 0) node_limit = strtoull(argv[i + 1], NULL, 10);
+    else if (strcmp(argv[i], "threads") == 0) threads = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "random") == 0) selfplay_random_plies = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "seed") == 0) selfplay_seed = strtoull(argv[i + 1], NULL, 10);
+  }
+
+  if (threads < 1) threads = 1;
+  if (threads > max_threads) threads = max_threads;
+  if (node_limit == 0) node_limit = 5000;
+
+  selfplay_output = fopen(argv[0], "wb");
+  if (selfplay_output == NULL) {
+    printf("can't create %s\n", argv[0]);
+    return 1;
+  }
+
+  // every thread can hold one buffer while the writer drains the others
+  selfplay_buffer_count = 2 * threads + 2;
+  selfplay_free_buffers = (selfplay_buffer**)malloc(selfplay_buffer_count * sizeof(selfplay_buffer*));
+  selfplay_full_buffers = (selfplay_buffer**)malloc(selfplay_buffer_count * sizeof(selfplay_buffer*));
+  for (int i = 0; i < selfplay_buffer_count; ++i) {
+    selfplay_free_buffers[i] = (selfplay_buffer*)malloc(sizeof(selfplay_buffer));
+  }
+  selfplay_free_count = selfplay_buffer_count;
+  selfplay_full_count = 0;
+  selfplay_writers_done = 0;
+
+  limits = (search_limits){ .depth = max_ply - 1, .nodes = node_limit };
+  stop_time = 0;
+  soft_time_limit = 0;
+  print_search_info = 0;
+  atomic_store(&selfplay_games_left, games);
+
+  uint64_t start = get_time_ms();
+
+  pthread_t writer;
+  pthread_create(&writer, NULL, selfplay_writer_main, NULL);
+
+  pthread_t workers[max_threads];
+  for (int i = 0; i < threads; ++i) pthread_create(&workers[i], NULL, selfplay_worker_main, (void*)(intptr_t)i);
+  for (int i = 0; i < threads; ++i) pthread_join(workers[i], NULL);
+
+  pthread_mutex_lock(&selfplay_mutex);
+  selfplay_writers_done = 1;
+  pthread_cond_signal(&selfplay_buffer_filled);
+  pthread_mutex_unlock(&selfplay_mutex);
+
+  pthread_join(writer, NULL);
+  fclose(selfplay_output);
+
+  for (int i = 0; i < selfplay_buffer_count; ++i) free(selfplay_free_buffers[i]);
+  free(selfplay_free_buffers);
+  free(selfplay_full_buffers);
+
+  uint64_t time = get_time_ms() - start;
+  uint64_t positions = atomic_load(&selfplay_positions);
+
+  printf("games %llu positions %llu time %llu ms positions/s %.1f\n",
+    (unsigned long long)atomic_load(&selfplay_games), (unsigned long long)positions, (unsigned long long)time, positions * 1000.0 / (time + 1));
+
+  return 0;
+}
+
+// =====================
+// PGN Index
+// =====================
+
+/*
+  main pgnindex build <index dir> <pgn files ...> [threads N]
+  main pgnindex fen <index dir> <FEN>
+  main pgnindex material <index dir> <signature, e.g. KRPvKR>
+
+  pgn files are mmapped and split into chunks at game starts, worker threads
+  replay the games with the move generator and collect every position
+  reached twice: keyed by zobrist hash_key and keyed by material_key().
+  when a worker's buffer is full it is sorted and written as a segment:
+
+    header        "SIDX", entries, blocks
+    block index   first key and data offset of every block of index_block_entries entries
+    data          per entry: varint key delta, varint game id, varint ply
+
+  queries map the segments, binary search the block index and decode one or
+  a few blocks. games.bin maps game ids to their file and byte range so
+  the games can be shown without rescanning the pgn.
+
+  hash keys come from the engine's zobrist keys, an index is only valid for
+  builds that generate the same keys. the enpassant key is only part of a
+  position key when the capture is legal (index_key), as in polyglot books
+*/
+
+#define index_segment_entries (1 << 20)
+#define index_block_entries 256
+
+typedef struct {
+  uint64_t key;
+  uint32_t game;
+  uint16_t ply;
+} index_entry;
+
+typedef struct {
+  uint64_t offset;
+  uint32_t length;
+  uint32_t file;
+} game_record;
+
+typedef struct {
+  const char* begin;
+  const char* end;
+  int file;
+  const char* file_begin;
+} pgn_chunk;
+
+pgn_chunk* pgn_chunk_list;
+int pgn_chunk_count;
+atomic_int pgn_next_chunk;
+
+const char* index_directory;
+atomic_int index_next_segment;
+atomic_uint index_next_game;
+_Atomic uint64_t index_positions;
+_Atomic uint64_t index_errors;
+
+// per worker state
+typedef struct {
+  index_entry* position_entries;
+  index_entry* material_entries;
+  int entry_count;
+  game_record* games;
+  uint32_t* game_ids;
+  int game_count;
+  int game_capacity;
+} index_worker;
+
+static inline uint8_t* write_varint(uint8_t* out, uint64_t value) {
+  while (value >= 0x80) {
+    *out++ = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  *out++ = (uint8_t)value;
+  return out;
+}
+
+static inline const uint8_t* read_varint(const uint8_t* in, uint64_t* value) {
+  uint64_t result = 0;
+  int shift = 0;
+
+  while (*in & 0x80) {
+    result |= (uint64_t)(*in++ & 0x7f) << shift;
+    shift += 7;
+  }
+  result |= (uint64_t)(*in++) << shift;
+
+  *value = result;
+  return in;
+}
+
+static int compare_index_entries(const void* a, const void* b) {
+  const index_entry* x = (const index_entry*)a;
+  const index_entry* y = (const index_entry*)b;
+
+  if (x->key != y->key) return (x->key < y->key) ? -1 : 1;
+  if (x->game != y->game) return (x->game < y->game) ? -1 : 1;
+  return (int)x->ply - (int)y->ply;
+}
+
+// sort entries and write them as a compressed segment
+void write_index_segment(index_entry* entries, const int count, const char* kind) {
+  if (count == 0) return;
+
+  qsort(entries, count, sizeof(index_entry), compare_index_entries);
+
+  int block_count = (count + index_block_entries - 1) / index_block_entries;
+
+  // worst case 10 + 5 + 3 bytes per entry
+  uint8_t* data = (uint8_t*)malloc((size_t)count * 18);
+  uint64_t* block_index = (uint64_t*)malloc(2 * block_count * sizeof(uint64_t));
+  uint8_t* out = data;
+
+  for (int i = 0; i < count; ++i) {
+    if (i % index_block_entries == 0) {
+      block_index[2 * (i / index_block_entries)] = entries[i].key;
+      block_index[2 * (i / index_block_entries) + 1] = out - data;
+    }
+
+    uint64_t delta = (i % index_block_entries == 0) ? 0 : entries[i].key - entries[i - 1].key;
+
+    out = write_varint(out, delta);
+    out = write_varint(out, entries[i].game);
+    out = write_varint(out, entries[i].ply);
+  }
+
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/%s-%05d.seg", index_directory, kind, atomic_fetch_add(&index_next_segment, 1));
+
+  FILE* file = fopen(path, "wb");
+  if (file) {
+    uint32_t header[4] = { 0x58444953, 1, (uint32_t)count, (uint32_t)block_count };
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(block_index, sizeof(uint64_t), 2 * block_count, file);
+    fwrite(data, 1, out - data, file);
+    fclose(file);
+  }
+
+  free(data);
+  free(block_index);
+}
+
+// legal move of the current position for a SAN move (e.g. Nbxd7+, e8=Q, O-O), 0 if there is none
+int parse_san(const char* san, const int length) {
+  moves move_list[1];
+  move_generation(move_list);
+
+  int end = length;
+
+  // check, mate and annotation marks
+  while (end > 0 && strchr("+#!?", san[end - 1])) --end;
+
+  int piece_type = P, source_file = -1, source_rank = -1, promoted_type = -1, destination_pos1D = -1;
+
+  if (end >= 3 && (san[0] == 'O' || san[0] == '0')) {
+    int queen_side = (end >= 5);
+    int king_pos1D = (side == white) ? e1 : e8;
+    destination_pos1D = king_pos1D + (queen_side ? -2 : 2);
+    piece_type = K;
+  }
+  else {
+    // promotion
+    if (end >= 2 && strchr("NBRQ", san[end - 1])) {
+      promoted_type = strchr("PNBRQK", san[end - 1]) - "PNBRQK";
+      --end;
+      if (end > 0 && san[end - 1] == '=') --end;
+    }
+
+    if (end < 2 || san[end - 2] < 'a' || san[end - 2] > 'h' || san[end - 1] < '1' || san[end - 1] > '8') return 0;
+
+    destination_pos1D = (san[end - 1] - '1') * 8 + (san[end - 2] - 'a');
+
+    int start = 0;
+    if (strchr("NBRQK", san[0])) {
+      piece_type = strchr("PNBRQK", san[0]) - "PNBRQK";
+      start = 1;
+    }
+
+    // disambiguation
+    for (int i = start; i < end - 2; ++i) {
+      if (san[i] >= 'a' && san[i] <= 'h') source_file = san[i] - 'a';
+      else if (san[i] >= '1' && san[i] <= '8') source_rank = san[i] - '1';
+    }
+  }
+
+  for (int i = 0; i < move_list->count; ++i) {
+    int move = move_list->moves[i];
+
+    if (get_move_destination(move) != destination_pos1D) continue;
+    if (get_move_piece(move) % 6 != piece_type) continue;
+    if (source_file >= 0 && (get_move_source(move) & 7) != source_file) continue;
+    if (source_rank >= 0 && (get_move_source(move) >> 3) != source_rank) continue;
+
+    int promoted_piece = get_move_promoted(move);
+    if ((promoted_piece ? promoted_piece % 6 : -1) != promoted_type) continue;
+
+    copy_board();
+    if (!make_move(move, all_moves)) continue;
+    take_back();
+
+    return move;
+  }
+
+  return 0;
+}
+
+// zobrist key of the current position, the enpassant square only counts when the capture is legal
+// so a position is found whether or not the FEN lists a square after a double push
+uint64_t index_key() {
+  if (enpassant_pos1D == out_of_bounds_pos1D) return hash_key;
+
+  uint64_t capturing_pawns = (side == white)
+    ? pawn_attacks[black][enpassant_pos1D] & piece_bitboards[P]
+    : pawn_attacks[white][enpassant_pos1D] & piece_bitboards[p];
+
+  if (capturing_pawns) {
+    moves move_list[1];
+    move_generation(move_list);
+
+    for (int i = 0; i < move_list->count; ++i) {
+      int move = move_list->moves[i];
+      if (!get_move_enpassant(move)) continue;
+
+      copy_board();
+      if (!make_move(move, all_moves)) continue;
+      take_back();
+
+      return hash_key;
+    }
+  }
+
+  return hash_key ^ enpassant_keys[enpassant_pos1D];
+}
+
+// record the current position for the game
+static inline void index_position(index_worker* worker, const uint32_t game, const int game_ply) {
+  if (worker->entry_count == index_segment_entries) {
+    write_index_segment(worker->position_entries, worker->entry_count, "pos");
+    write_index_segment(worker->material_entries, worker->entry_count, "mat");
+    worker->entry_count = 0;
+  }
+
+  worker->position_entries[worker->entry_count] = (index_entry){ index_key(), game, (uint16_t)game_ply };
+  worker->material_entries[worker->entry_count] = (index_entry){ material_key(), game, (uint16_t)game_ply };
+  ++worker->entry_count;
+}
+
+// replay the games of a chunk
+void index_chunk(index_worker* worker, const pgn_chunk* chunk) {
+  const char* line = chunk->begin;
+
+  const char* game_begin = NULL;
+  uint32_t game = 0;
+  int game_ply = 0, in_movetext = 0, replaying = 0;
+  int comment = 0, variation = 0;
+
+  while (1) {
+    const char* line_end = (line < chunk->end) ? memchr(line, '\n', chunk->end - line) : NULL;
+    if (line < chunk->end && line_end == NULL) line_end = chunk->end;
+
+    // a tag after movetext (or the end of the chunk) finishes the game
+    int game_done = game_begin && (line >= chunk->end || (*line == '[' && in_movetext && !comment));
+
+    if (game_done) {
+      if (!in_movetext) index_position(worker, game, 0);
+
+      if (worker->game_count == worker->game_capacity) {
+        worker->game_capacity = 2 * worker->game_capacity + 1024;
+        worker->games = (game_record*)realloc(worker->games, worker->game_capacity * sizeof(game_record));
+        worker->game_ids = (uint32_t*)realloc(worker->game_ids, worker->game_capacity * sizeof(uint32_t));
+      }
+
+      worker->games[worker->game_count] = (game_record){ (uint64_t)(game_begin - chunk->file_begin), (uint32_t)(line - game_begin), (uint32_t)chunk->file };
+      worker->game_ids[worker->game_count] = game;
+      ++worker->game_count;
+
+      atomic_fetch_add(&index_positions, game_ply + 1);
+      game_begin = NULL;
+    }
+
+    if (line >= chunk->end) break;
+
+    if (*line == '[' && !comment && (game_begin == NULL || !in_movetext)) {
+      // new game
+      if (game_begin == NULL) {
+        game_begin = line;
+        game = atomic_fetch_add(&index_next_game, 1);
+        game_ply = 0;
+        in_movetext = 0;
+        replaying = 1;
+        variation = 0;
+        parse_FEN(start_position);
+      }
+
+      // set up position
+      if (strncmp(line, "[FEN \"", 6) == 0) {
+        const char* error;
+        const char* fen_end = memchr(line + 6, '"', line_end - line - 6);
+        if (fen_end == NULL || parse_FEN_checked(line + 6, fen_end, &error) == NULL) replaying = 0;
+      }
+    }
+    else if (game_begin && *line != '%') {
+      if (!in_movetext) {
+        in_movetext = 1;
+        index_position(worker, game, 0);
+      }
+
+      // movetext tokens
+      const char* current = line;
+      while (current < line_end) {
+        char c = *current;
+
+        if (comment) {
+          // comments don't nest in the standard, but some files do it anyway
+          if (c == '{') ++comment;
+          else if (c == '}') --comment;
+          ++current;
+        }
+        else if (c == '{') {
+          comment = 1;
+          ++current;
+        }
+        else if (c == '}') {
+          // stray closing brace, e.g. the end of a nested comment
+          ++current;
+        }
+        else if (c == ';') {
+          // comment to the end of the line
+          break;
+        }
+        else if (c == '(') {
+          ++variation;
+          ++current;
+        }
+        else if (c == ')') {
+          if (variation) --variation;
+          ++current;
+        }
+        else if (c == ' ' || c == '\t' || c == '\r' || c == '.') {
+          ++current;
+        }
+        else {
+          const char* token = current;
+          while (current < line_end && *current && !strchr(" \t\r{}();", *current)) ++current;
+
+          int length = (int)(current - token);
+
+          // a byte that can't start a token (e.g. a nul) is skipped
+          if (length == 0) {
+            ++current;
+            continue;
+          }
+
+          // nags and moves of variations are skipped
+          if (variation || !replaying || *token == '$' || *token == '*') continue;
+
+          if (*token >= '0' && *token <= '9') {
+            int digits = 0;
+            while (digits < length && token[digits] >= '0' && token[digits] <= '9') ++digits;
+
+            if (digits < length && token[digits] == '.') {
+              // move number, possibly glued to the move (12.e4, 12...Nf6)
+              while (digits < length && token[digits] == '.') ++digits;
+              token += digits;
+              length -= digits;
+            }
+            // results (1-0, 0-1, 1/2-1/2) but not castling written with zeros
+            else if (!(length >= 3 && strncmp(token, "0-0", 3) == 0)) continue;
+          }
+
+          if (length == 0) continue;
+
+          int move = parse_san(token, length);
+
+          if (move == 0) {
+            // unreadable or illegal move, the rest of the game is skipped
+            replaying = 0;
+            atomic_fetch_add(&index_errors, 1);
+            continue;
+          }
+
+          make_move(move, all_moves);
+          ++game_ply;
+          index_position(worker, game, game_ply);
+        }
+      }
+    }
+
+    line = line_end + 1;
+  }
+}
+
+void* index_worker_main(void* arg) {
+  index_worker* worker = (index_worker*)arg;
+
+  worker->position_entries = (index_entry*)malloc(index_segment_entries * sizeof(index_entry));
+  worker->material_entries = (index_entry*)malloc(index_segment_entries * sizeof(index_entry));
+  worker->entry_count = 0;
+
+  int index;
+
+  while ((index = atomic_fetch_add(&pgn_next_chunk, 1)) < pgn_chunk_count) {
+    index_chunk(worker, &pgn_chunk_list[index]);
+  }
+
+  write_index_segment(worker->position_entries, worker->entry_count, "pos");
+  write_index_segment(worker->material_entries, worker->entry_count, "mat");
+
+  free(worker->position_entries);
+  free(worker->material_entries);
+
+  return NULL;
+}
+
+// start of the first game at or after position
+static const char* next_game_start(const char* position, const char* begin, const char* end) {
+  // a game starts with a tag at the beginning of a line that follows a non tag line
+  while (position < end) {
+    const char* newline = memchr(position, '\n', end - position);
+    if (newline == NULL) return end;
+
+    if (newline + 1 < end && newline[1] == '[' && newline > begin) {
+      // previous line is blank or movetext
+      const char* previous = newline - 1;
+      while (previous > begin && *previous == '\r') --previous;
+      const char* previous_line = previous;
+      while (previous_line > begin && previous_line[-1] != '\n') --previous_line;
+
+      if (*previous_line != '[') return newline + 1;
+    }
+
+    position = newline + 1;
+  }
+
+  return end;
+}
+
+int index_build(const char* directory, char** files, const int file_count, const int threads) {
+  mkdir(directory, 0755);
+  index_directory = directory;
+
+  const char** data = (const char**)calloc(file_count, sizeof(char*));
+  size_t* sizes = (size_t*)calloc(file_count, sizeof(size_t));
+
+  int max_chunks = 0;
+
+  for (int i = 0; i < file_count; ++i) {
+    int fd = open(files[i], O_RDONLY);
+    struct stat file_stat;
+
+    if (fd < 0 || fstat(fd, &file_stat) || file_stat.st_size == 0) {
+      printf("can't open %s\n", files[i]);
+      if (fd >= 0) close(fd);
+      continue;
+    }
+
+    sizes[i] = file_stat.st_size;
+    data[i] = (const char*)mmap(NULL, sizes[i], PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data[i] == MAP_FAILED) {
+      data[i] = NULL;
+      continue;
+    }
+
+    madvise((void*)data[i], sizes[i], MADV_SEQUENTIAL);
+    max_chunks += (int)(sizes[i] >> 22) + threads + 1;
+  }
+
+  // chunks of about 4 MB, at least a few per thread
+  pgn_chunk_list = (pgn_chunk*)calloc(max_chunks, sizeof(pgn_chunk));
+  pgn_chunk_count = 0;
+
+  for (int i = 0; i < file_count; ++i) {
+    if (data[i] == NULL) continue;
+
+    const char* end = data[i] + sizes[i];
+    size_t chunk_size = sizes[i] / (threads + 1) + 1;
+    if (chunk_size > (1 << 22)) chunk_size = 1 << 22;
+
+    const char* current = data[i];
+
+    while (current < end && pgn_chunk_count < max_chunks) {
+      const char* chunk_end = (pgn_chunk_count == max_chunks - 1 || (size_t)(end - current) <= chunk_size) ? end : next_game_start(current + chunk_size, data[i], end);
+
+      pgn_chunk_list[pgn_chunk_count++] = (pgn_chunk){ current, chunk_end, i, data[i] };
+      current = chunk_end;
+    }
+  }
+
+  uint64_t start = get_time_ms();
+
+  index_worker workers[max_threads];
+  pthread_t worker_threads[max_threads];
+  memset(workers, 0, sizeof(workers));
+
+  atomic_store(&pgn_next_chunk, 0);
+  for (int i = 0; i < threads; ++i) pthread_create(&worker_threads[i], NULL, index_worker_main, &workers[i]);
+  for (int i = 0; i < threads; ++i) pthread_join(worker_threads[i], NULL);
+
+  // game table in id order
+  uint32_t game_count = atomic_load(&index_next_game);
+  game_record* games = (game_record*)calloc(game_count ? game_count : 1, sizeof(game_record));
+
+  for (int i = 0; i < threads; ++i) {
+    for (int j = 0; j < workers[i].game_count; ++j) games[workers[i].game_ids[j]] = workers[i].games[j];
+    free(workers[i].games);
+    free(workers[i].game_ids);
+  }
+
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/games.bin", directory);
+  FILE* file = fopen(path, "wb");
+  if (file) {
+    fwrite(games, sizeof(game_record), game_count, file);
+    fclose(file);
+  }
+
+  snprintf(path, sizeof(path), "%s/files.txt", directory);
+  file = fopen(path, "w");
+  if (file) {
+    for (int i = 0; i < file_count; ++i) fprintf(file, "%s\n", files[i]);
+    fclose(file);
+  }
+
+  printf("games %u positions %llu errors %llu segments %d time %llu ms\n", game_count,
+    (unsigned long long)atomic_load(&index_positions), (unsigned long long)atomic_load(&index_errors),
+    atomic_load(&index_next_segment), (unsigned long long)(get_time_ms() - start));
+
+  for (int i = 0; i < file_count; ++i) {
+    if (data[i]) munmap((void*)data[i], sizes[i]);
+  }
+
+  free(games);
+  free(pgn_chunk_list);
+  free(data);
+  free(sizes);
+
+  return 0;
+}
+
+// collect games with key from the segments of kind, returns the number of matches found
+int index_lookup(const char* directory, const char* kind, const uint64_t key, uint32_t* game_ids, uint16_t* plies, const int max_matches) {
+  DIR* dir = opendir(directory);
+  if (dir == NULL) return 0;
+
+  int count = 0;
+  size_t kind_length = strlen(kind);
+  struct dirent* dir_entry;
+
+  while ((dir_entry = readdir(dir)) != NULL) {
+    if (strncmp(dir_entry->d_name, kind, kind_length) != 0 || strstr(dir_entry->d_name, ".seg") == NULL) continue;
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", directory, dir_entry->d_name);
+
+    int fd = open(path, O_RDONLY);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) || file_stat.st_size < 16) {
+      if (fd >= 0) close(fd);
+      continue;
+    }
+
+    const uint8_t* segment = (const uint8_t*)mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) continue;
+
+    const uint32_t* header = (const uint32_t*)segment;
+    uint32_t entry_count = header[2], block_count = header[3];
+    const uint64_t* block_index = (const uint64_t*)(segment + 16);
+    const uint8_t* block_data = segment + 16 + 16 * (size_t)block_count;
+
+    if (header[0] == 0x58444953 && block_count) {
+      // last block starting below key, equal keys may begin in it
+      uint32_t low = 0, high = block_count;
+      while (low < high) {
+        uint32_t middle = (low + high) / 2;
+        if (block_index[2 * middle] < key) low = middle + 1;
+        else high = middle;
+      }
+
+      for (uint32_t block = (low > 0) ? low - 1 : 0; block < block_count && count < max_matches; ++block) {
+        if (block_index[2 * block] > key) break;
+
+        const uint8_t* in = block_data + block_index[2 * block + 1];
+        uint64_t entry_key = block_index[2 * block];
+        uint32_t entries = (block == block_count - 1) ? entry_count - block * index_block_entries : index_block_entries;
+
+        for (uint32_t i = 0; i < entries && count < max_matches; ++i) {
+          uint64_t delta, game, ply;
+          in = read_varint(in, &delta);
+          in = read_varint(in, &game);
+          in = read_varint(in, &ply);
+
+          entry_key += delta;
+
+          if (entry_key > key) break;
+          if (entry_key < key) continue;
+
+          // several positions of one game in a row count once
+          if (count && game_ids[count - 1] == game) continue;
+
+          game_ids[count] = (uint32_t)game;
+          plies[count] = (uint16_t)ply;
+          ++count;
+        }
+      }
+    }
+
+    munmap((void*)segment, file_stat.st_size);
+  }
+
+  closedir(dir);
+
+  return count;
+}
+
+// print the value of a tag of a pgn game (e.g. White)
+static void print_pgn_tag(const char* game, const size_t length, const char* tag) {
+  char pattern[32];
+  snprintf(pattern, sizeof(pattern), "[%s \"", tag);
+
+  size_t pattern_length = strlen(pattern);
+
+  for (const char* line = game; line < game + length; ) {
+    const char* line_end = memchr(line, '\n', game + length - line);
+    if (line_end == NULL) line_end = game + length;
+
+    if ((size_t)(line_end - line) > pattern_length && strncmp(line, pattern, pattern_length) == 0) {
+      const char* value = line + pattern_length;
+      const char* value_end = memchr(value, '"', line_end - value);
+      printf("%.*s", (int)(value_end ? value_end - value : line_end - value), value);
+      return;
+    }
+
+    line = line_end + 1;
+  }
+
+  printf("?");
+}
+
+// print the matches of a query with the players and result of each game
+void index_print_matches(const char* directory, const uint32_t* game_ids, const uint16_t* plies, const int count) {
+  char path[4096];
+  char files[64][4096];
+  int file_count = 0;
+
+  snprintf(path, sizeof(path), "%s/files.txt", directory);
+  FILE* list = fopen(path, "r");
+  while (list && file_count < 64 && fgets(files[file_count], sizeof(files[0]), list)) {
+    files[file_count][strcspn(files[file_count], "\r\n")] = '\0';
+    ++file_count;
+  }
+  if (list) fclose(list);
+
+  snprintf(path, sizeof(path), "%s/games.bin", directory);
+  FILE* games = fopen(path, "rb");
+
+  printf("games %d\n", count);
+
+  for (int i = 0; i < count && games; ++i) {
+    game_record record;
+
+    fseek(games, (long)game_ids[i] * sizeof(game_record), SEEK_SET);
+    if (fread(&record, sizeof(record), 1, games) != 1) continue;
+
+    printf("game %u ply %u  ", game_ids[i], plies[i]);
+
+    FILE* pgn = (record.file < (uint32_t)file_count) ? fopen(files[record.file], "rb") : NULL;
+    char* text = (char*)malloc(record.length + 1);
+
+    if (pgn && fseek(pgn, (long)record.offset, SEEK_SET) == 0 && fread(text, 1, record.length, pgn) == record.length) {
+      print_pgn_tag(text, record.length, "White");
+      printf(" - ");
+      print_pgn_tag(text, record.length, "Black");
+      printf("  ");
+      print_pgn_tag(text, record.length, "Result");
+    }
+    printf("\n");
+
+    free(text);
+    if (pgn) fclose(pgn);
+  }
+
+  if (games) fclose(games);
+}
+
+int pgnindex_main(const int argc, char* argv[]) {
+  if (argc < 3) {
+    printf("usage: pgnindex build <index> <pgn files ...> [threads N]\n");
+    printf("       pgnindex fen <index> <FEN>\n");
+    printf("       pgnindex material <index> <signature, e.g. KRPvKR>\n");
+    return 1;
+  }
+
+  if (strcmp(argv[0], "build") == 0) {
+    int threads = 1, file_count = argc - 2;
+
+    if (argc >= 5 && strcmp(argv[argc - 2], "threads") == 0) {
+      threads = atoi(argv[argc - 1]);
+      file_count -= 2;
+    }
+
+    if (threads < 1) threads = 1;
+    if (threads > max_threads) threads = max_threads;
+
+    return index_build(argv[1], argv + 2, file_count, threads);
+  }
+
+  uint64_t key;
+  const char* kind;
+
+  if (strcmp(argv[0], "fen") == 0) {
+    // the FEN may come as one argument or split over several
+    char fen[256] = "";
+    for (int i = 2; i < argc; ++i) {
+      strncat(fen, argv[i], sizeof(fen) - strlen(fen) - 2);
+      strcat(fen, " ");
+    }
+
+    const char* error;
+    if (parse_FEN_checked(fen, fen + strlen(fen), &error) == NULL) {
+      printf("invalid FEN: %s\n", error);
+      return 1;
+    }
+
+    key = index_key();
+    kind = "pos";
+  }
+  else if (strcmp(argv[0], "material") == 0) {
+    // KRPvKR: white pieces before the v, black pieces after it
+    int color = white;
+    memset(piece_bitboards, 0, sizeof(piece_bitboards));
+
+    for (const char* c = argv[2]; *c; ++c) {
+      if (*c == 'v') {
+        color = black;
+        continue;
+      }
+
+      const char* type = strchr("PNBRQK", *c);
+      if (type == NULL) {
+        printf("invalid material signature\n");
+        return 1;
+      }
+
+      // only the piece counts matter
+      int piece = (int)(type - "PNBRQK") + ((color == white) ? P : p);
+      piece_bitboards[piece] = (piece_bitboards[piece] << 1) | 1ULL;
+    }
+
+    key = material_key();
+    kind = "mat";
+  }
+  else {
+    printf("unknown pgnindex command %s\n", argv[0]);
+    return 1;
+  }
+
+  uint64_t start = get_time_ms();
+
+  uint32_t game_ids[1000];
+  uint16_t plies[1000];
+  int count = index_lookup(argv[1], kind, key, game_ids, plies, 1000);
+
+  printf("lookup %llu ms\n", (unsigned long long)(get_time_ms() - start));
+  index_print_matches(argv[1], game_ids, plies, count);
+
+  return 0;
+}
+
+// =====================
+// Bench
+// =====================
+
+/*
+  main bench [depth N] [hash MB]
+
+  searches a fixed set of positions to a fixed depth on one thread with a
+  cleared hash table. the total node count is a signature of the search,
+  any functional change changes it, pure speed changes don't. nps and the
+  hardware counters (when perf_event_open is allowed) measure the speed
+*/
+
+char* bench_positions[] = {
+  start_position,
+  tricky_position,
+  killer_position,
+  cmk_position,
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+  "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+  "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+  "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/8 b - - 3 54",
+  "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1"
+};
+
+#define bench_position_count (int)(sizeof(bench_positions) / sizeof(bench_positions[0]))
+
+#define perf_counter_count 4
+
+const char* perf_counter_names[perf_counter_count] = { "cycles", "instructions", "branch-misses", "llc-misses" };
+
+#ifdef __linux__
+// open a counter of the calling thread, -1 if the kernel doesn't allow it
+int open_perf_counter(const int counter) {
+  const uint64_t configs[perf_counter_count] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES };
+
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = configs[counter];
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#else
+int open_perf_counter(const int counter) {
+  return -1;
+}
+#endif
+
+int bench_main(const int argc, char* argv[]) {
+  int depth = 11, hash_mb = 16;
+
+  for (int i = 0; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "depth") == 0) depth = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "hash") == 0) hash_mb = atoi(argv[i + 1]);
+  }
+
+  if (depth < 1) depth = 1;
+  if (depth > max_ply - 1) depth = max_ply - 1;
+  if (hash_mb < 1) hash_mb = 1;
+
+  init_hash_table(hash_mb);
+
+  print_search_info = 0;
+  limits = (search_limits){ .depth = depth };
+  stop_time = 0;
+  soft_time_limit = 0;
+  atomic_store(&stop_search, 0);
+
+  int perf_fds[perf_counter_count];
+  for (int i = 0; i < perf_counter_count; ++i) perf_fds[i] = open_perf_counter(i);
+
+#ifdef __linux__
+  for (int i = 0; i < perf_counter_count; ++i) {
+    if (perf_fds[i] < 0) continue;
+    ioctl(perf_fds[i], PERF_EVENT_IOC_RESET, 0);
+    ioctl(perf_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+
+  uint64_t total_nodes = 0;
+  uint64_t start = get_time_ms();
+
+  for (int i = 0; i < bench_position_count; ++i) {
+    parse_FEN(bench_positions[i]);
+    clear_hash_table();
+    clear_move_history();
+
+    start_time = get_time_ms();
+    int best_move = search_position(depth);
+    total_nodes += nodes;
+
+    char move_string[6];
+    printf("position %2d  bestmove %-5s  nodes %12llu\n", i + 1, move_to_string(best_move, move_string), (unsigned long long)nodes);
+  }
+
+  uint64_t elapsed = get_time_ms() - start;
+
+  uint64_t counters[perf_counter_count] = { 0 };
+  int counters_read = 0;
+
+#ifdef __linux__
+  for (int i = 0; i < perf_counter_count; ++i) {
+    if (perf_fds[i] < 0) continue;
+    ioctl(perf_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    if (read(perf_fds[i], &counters[i], sizeof(uint64_t)) == sizeof(uint64_t)) ++counters_read;
+    close(perf_fds[i]);
+  }
+#endif
+
+  printf("\n");
+  printf("depth          %d\n", depth);
+  printf("time           %llu ms\n", (unsigned long long)elapsed);
+  printf("nps            %llu\n", (unsigned long long)(total_nodes * 1000 / (elapsed ? elapsed : 1)));
+
+  if (counters_read == 0) {
+    printf("perf counters  unavailable\n");
+  }
+  else {
+    for (int i = 0; i < perf_counter_count; ++i) {
+      if (perf_fds[i] >= 0) printf("%-14s %llu\n", perf_counter_names[i], (unsigned long long)counters[i]);
+    }
+
+    if (perf_fds[0] >= 0 && perf_fds[1] >= 0 && counters[0]) printf("ipc            %.2f\n", (double)counters[1] / counters[0]);
+    if (perf_fds[0] >= 0) printf("cycles/node    %.1f\n", (double)counters[0] / (total_nodes ? total_nodes : 1));
+  }
+
+  print_stats_report("");
+
+  // signature last, scripts compare this line between builds
+  printf("nodes          %llu\n", (unsigned long long)total_nodes);
+
+  return 0;
+}
+
+// =====================
+// Tablebase Check
+// =====================
+
+/*
+  main tbcheck <syzygy path>
+
+  probes positions with known results against the tables of the path, to
+  check the decoding and indexing against the real files: wdl and dtz of
+  KQvK, KRvK and KPvK positions and the root ranking of mates in one, the
+  pawn up one needs KQPvK. exits with 1 if any probe disagrees
+*/
+
+typedef struct {
+  char* fen;
+  int wdl;
+
+  // dtz range, exact where the distance is known
+  int dtz_min, dtz_max;
+} tb_known_position;
+
+const tb_known_position tb_known_positions[] = {
+  // Qb8 mate in one, the loser to move
+  { "7k/8/6K1/8/8/8/8/1Q6 w - - 0 1", wdl_win, 1, 1 },
+  { "7k/8/6K1/8/8/8/8/1Q6 b - - 0 1", wdl_loss, -100, -1 },
+  // rook far from the black king
+  { "8/8/8/4k3/8/8/8/R3K3 w - - 0 1", wdl_win, 1, 100 },
+  { "8/8/8/4k3/8/8/8/R3K3 b - - 0 1", wdl_loss, -100, -1 },
+  // promotion next move (zeroing, dtz 1) and a rook pawn with the king in the corner
+  { "8/4P3/4K3/8/8/8/8/k7 w - - 0 1", wdl_win, 1, 1 },
+  { "8/4P3/4K3/8/8/8/8/k7 b - - 0 1", wdl_loss, -100, -1 },
+  { "k7/8/8/8/8/8/P7/K7 w - - 0 1", wdl_draw, 0, 0 },
+  { "k7/8/8/8/8/8/P7/K7 b - - 0 1", wdl_draw, 0, 0 }
+};
+
+#define tb_known_position_count (int)(sizeof(tb_known_positions) / sizeof(tb_known_positions[0]))
+
+typedef struct {
+  char* fen;
+  char* move;
+
+  // the move must be the only one kept (1) or one of them (0)
+  int only;
+} tb_known_root;
+
+const tb_known_root tb_known_roots[] = {
+  // Qb8 mate
+  { "7k/8/6K1/8/8/8/8/1Q6 w - - 0 1", "b1b8", 1 },
+  // the same mate next to winning pawn moves (dtz 1 each), the mate must stay
+  { "7k/8/6K1/8/8/8/P7/1Q6 w - - 0 1", "b1b8", 0 }
+};
+
+#define tb_known_root_count (int)(sizeof(tb_known_roots) / sizeof(tb_known_roots[0]))
+
+int tbcheck_main(const int argc, char* argv[]) {
+  if (argc < 1) {
+    printf("usage: tbcheck <syzygy path>\n");
+    return 1;
+  }
+
+  init_tablebases(argv[0]);
+
+  if (tb_largest < 3) {
+    printf("no 3 piece tables in %s\n", argv[0]);
+    return 1;
+  }
+
+  int failures = 0;
+
+  for (int i = 0; i < tb_known_position_count; ++i) {
+    const tb_known_position* known = &tb_known_positions[i];
+    parse_FEN(known->fen);
+
+    int wdl_result, dtz_result;
+    int wdl = tb_probe_wdl(&wdl_result);
+    int dtz = tb_probe_dtz(&dtz_result);
+
+    int passed = wdl_result != tb_fail && dtz_result != tb_fail && wdl == known->wdl &&
+                 dtz >= known->dtz_min && dtz <= known->dtz_max;
+
+    if (!passed) ++failures;
+
+    printf("%-4s wdl %2d dtz %4d  expected wdl %2d dtz %d..%d  %s%s\n", passed ? "ok" : "FAIL", wdl, dtz,
+      known->wdl, known->dtz_min, known->dtz_max, known->fen, (wdl_result == tb_fail || dtz_result == tb_fail) ? "  (probe failed)" : "");
+  }
+
+  // root ranking
+  for (int i = 0; i < tb_known_root_count; ++i) {
+    const tb_known_root* known = &tb_known_roots[i];
+    parse_FEN(known->fen);
+
+    moves ranked = { .count = 0 };
+    int ranked_ok = tb_rank_root_moves(&ranked);
+
+    char moves_string[256] = "";
+    char move_string[6];
+    int found = 0;
+
+    for (int j = 0; ranked_ok && j < ranked.count; ++j) {
+      move_to_string(ranked.moves[j], move_string);
+      if (strcmp(move_string, known->move) == 0) found = 1;
+
+      if (strlen(moves_string) + 7 < sizeof(moves_string)) {
+        strcat(moves_string, " ");
+        strcat(moves_string, move_string);
+      }
+    }
+
+    int passed = ranked_ok && found && (!known->only || ranked.count == 1);
+
+    if (!passed) ++failures;
+
+    printf("%-4s root moves%s  expected %s%s  %s%s\n", passed ? "ok" : "FAIL", moves_string, known->only ? "only " : "", known->move,
+      known->fen, ranked_ok ? "" : "  (probe failed)");
+  }
+
+  printf("%d of %d checks failed\n", failures, tb_known_position_count + tb_known_root_count);
+
+  return failures != 0;
+}
+
+// =====================
+// Analysis Server
+// =====================
+
+/*
+  main server <socket path> [threads N] [hash MB] [slice MS]
+
+  long running server on a unix domain socket, every connection is a
+  session that can queue any number of analyses
+
+    analyse <id> fen <FEN> [depth N] [nodes N] [movetime N]
+    stop [id]
+    quit
+
+  and gets its results streamed back as soon as they are available
+
+    info <id> depth 9 score cp 31 nodes 182734 time 210 pv e2e4 e7e5 ...
+    bestmove <id> e2e4
+    error <id> <message>
+
+  analyses of all sessions share one run queue served by a fixed pool of
+  worker threads, and the attack and hash tables. a worker searches an
+  analysis for one time slice and puts it back at the end of the queue, so
+  long analyses can't starve short ones. the next slice resumes iterative
+  deepening at the interrupted depth with the hash table keeping the work
+  done, an analysis that couldn't finish an iteration gets a longer slice
+*/
+
+#define server_default_depth 12
+#define server_max_slice_ms 2000
+
+typedef struct server_analysis server_analysis;
+
+typedef struct {
+  int fd;
+
+  // writes and the analysis list
+  pthread_mutex_t mutex;
+  server_analysis* analyses;
+
+  // reader thread and queued analyses
+  atomic_int references;
+  atomic_int closed;
+} server_session;
+
+struct server_analysis {
+  server_session* session;
+  server_analysis* next_in_queue;
+  server_analysis* next_in_session;
+
+  char id[32];
+  char fen[128];
+
+  int depth;
+  int next_depth;
+  uint64_t node_limit;
+  uint64_t nodes;
+  uint64_t start_time;
+  uint64_t deadline;
+  int slice_ms;
+
+  int best_move;
+
+  // stop of the current slice, set by the slice's limits and by cancel
+  atomic_int stop;
+  atomic_int cancel;
+};
+
+int server_slice_ms = 50;
+
+server_analysis* server_queue_head;
+server_analysis* server_queue_tail;
+pthread_mutex_t server_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t server_queue_ready = PTHREAD_COND_INITIALIZER;
+
+// send a formatted line to the session, marks the session closed when the client is gone
+void server_send(server_session* session, const char* format, ...) {
+  char line[4096];
+
+  va_list arguments;
+  va_start(arguments, format);
+  int length = vsnprintf(line, sizeof(line), format, arguments);
+  va_end(arguments);
+
+  if (length < 0) return;
+  if (length >= (int)sizeof(line)) length = sizeof(line) - 1;
+
+  int sent = 0;
+  while (sent < length && !atomic_load(&session->closed)) {
+    ssize_t result = send(session->fd, line + sent, length - sent, MSG_NOSIGNAL);
+    if (result <= 0) {
+      atomic_store(&session->closed, 1);
+      break;
+    }
+    sent += result;
+  }
+}
+
+void server_release(server_session* session) {
+  if (atomic_fetch_sub(&session->references, 1) == 1) {
+    close(session->fd);
+    pthread_mutex_destroy(&session->mutex);
+    free(session);
+  }
+}
+
+void server_enqueue(server_analysis* analysis) {
+  analysis->next_in_queue = NULL;
+
+  pthread_mutex_lock(&server_queue_mutex);
+  if (server_queue_tail) server_queue_tail->next_in_queue = analysis;
+  else server_queue_head = analysis;
+  server_queue_tail = analysis;
+  pthread_cond_signal(&server_queue_ready);
+  pthread_mutex_unlock(&server_queue_mutex);
+}
+
+server_analysis* server_dequeue() {
+  pthread_mutex_lock(&server_queue_mutex);
+  while (server_queue_head == NULL) pthread_cond_wait(&server_queue_ready, &server_queue_mutex);
+
+  server_analysis* analysis = server_queue_head;
+  server_queue_head = analysis->next_in_queue;
+  if (server_queue_head == NULL) server_queue_tail = NULL;
+  pthread_mutex_unlock(&server_queue_mutex);
+
+  return analysis;
+}
+
+// stream the info line of a completed iteration
+void server_send_info(server_analysis* analysis, const int score, const int depth) {
+  char line[4096];
+  int length;
+
+  if (score > -mate_value && score < -mate_score) length = snprintf(line, sizeof(line), "score mate %d", -(score + mate_value) / 2 - 1);
+  else if (score > mate_score && score < mate_value) length = snprintf(line, sizeof(line), "score mate %d", (mate_value - score) / 2 + 1);
+  else length = snprintf(line, sizeof(line), "score cp %d", score);
+
+  length += snprintf(line + length, sizeof(line) - length, " nodes %llu time %llu pv", (unsigned long long)(analysis->nodes + nodes),
+    (unsigned long long)(get_time_ms() - analysis->start_time));
+
+  char move_string[6];
+  for (int i = 0; i < pv_length[0] && length < (int)sizeof(line) - 8; ++i) {
+    length += snprintf(line + length, sizeof(line) - length, " %s", move_to_string(pv_table[0][i], move_string));
+  }
+
+  server_send(analysis->session, "info %s depth %d %s\n", analysis->id, depth, line);
+}
+
+// search an analysis for one slice, returns 1 when the analysis is finished
+int server_run_slice(server_analysis* analysis) {
+  if (atomic_load(&analysis->cancel) || atomic_load(&analysis->session->closed)) return 1;
+
+  const char* error;
+  parse_FEN_checked(analysis->fen, analysis->fen + strlen(analysis->fen), &error);
+
+  stop_flag = &analysis->stop;
+  atomic_store(stop_flag, 0);
+
+  // a cancel between the check above and the reset is not lost
+  if (atomic_load(&analysis->cancel)) atomic_store(stop_flag, 1);
+
+  reset_search_state();
+
+  if (analysis->next_depth == 1) new_hash_generation();
+
+  uint64_t slice_start = get_time_ms();
+  thread_stop_time = slice_start + analysis->slice_ms;
+  if (analysis->deadline && analysis->deadline < thread_stop_time) thread_stop_time = analysis->deadline;
+  thread_node_limit = analysis->node_limit ? analysis->node_limit - analysis->nodes : 0;
+
+  int completed_iterations = 0;
+
+  for (; analysis->next_depth <= analysis->depth; ++analysis->next_depth) {
+    int score = negamax(-infinity, infinity, analysis->next_depth, 1);
+
+    if (search_stopped()) break;
+
+    analysis->best_move = pv_table[0][0];
+    ++completed_iterations;
+
+    server_send_info(analysis, score, analysis->next_depth);
+  }
+
+  analysis->nodes += nodes;
+
+  thread_stop_time = 0;
+  thread_node_limit = 0;
+  stop_flag = &stop_search;
+
+  if (completed_iterations == 0 && analysis->slice_ms < server_max_slice_ms) analysis->slice_ms *= 2;
+
+  return analysis->next_depth > analysis->depth ||
+    atomic_load(&analysis->cancel) || atomic_load(&analysis->session->closed) ||
+    (analysis->deadline && get_time_ms() >= analysis->deadline) ||
+    (analysis->node_limit && analysis->nodes >= analysis->node_limit);
+}
+
+// send bestmove and drop the analysis from its session
+void server_finish(server_analysis* analysis) {
+  server_session* session = analysis->session;
+  char move_string[6];
+
+  pthread_mutex_lock(&session->mutex);
+
+  server_analysis** link = &session->analyses;
+  while (*link != analysis) link = &(*link)->next_in_session;
+  *link = analysis->next_in_session;
+
+  server_send(session, "bestmove %s %s\n", analysis->id, move_to_string(analysis->best_move, move_string));
+
+  pthread_mutex_unlock(&session->mutex);
+
+  server_release(session);
+  free(analysis);
+}
+
+void* server_worker_main(void* arg) {
+  // independent searches: own limits and stop flag per analysis
+  thread_id = 0;
+
+  while (1) {
+    server_analysis* analysis = server_dequeue();
+
+    if (server_run_slice(analysis)) server_finish(analysis);
+    else server_enqueue(analysis);
+  }
+
+  return NULL;
+}
+
+// stop the analyses of the session with the given id (all when id is NULL)
+void server_cancel(server_session* session, const char* id) {
+  pthread_mutex_lock(&session->mutex);
+
+  for (server_analysis* analysis = session->analyses; analysis; analysis = analysis->next_in_session) {
+    if (id && strcmp(analysis->id, id) != 0) continue;
+
+    atomic_store(&analysis->cancel, 1);
+    atomic_store(&analysis->stop, 1);
+  }
+
+  pthread_mutex_unlock(&session->mutex);
+}
+
+// analyse <id> fen <FEN> [depth N] [nodes N] [movetime N]
+void server_parse_analyse(server_session* session, char* command) {
+  char id[32] = "";
+  sscanf(command, "analyse %31s", id);
+
+  char* fen = strstr(command, " fen ");
+  if (id[0] == '\0' || fen == NULL) {
+    server_send(session, "error %s expected: analyse <id> fen <FEN> [depth N] [nodes N] [movetime N]\n", id[0] ? id : "-");
+    return;
+  }
+
+  fen += 5;
+
+  // the FEN ends at the first limit
+  char* fen_end = fen + strlen(fen);
+  const char* names[] = { " depth ", " nodes ", " movetime " };
+  for (int i = 0; i < 3; ++i) {
+    char* limit = strstr(fen, names[i]);
+    if (limit && limit < fen_end) fen_end = limit;
+  }
+
+  const char* error = NULL;
+
+  if (fen_end - fen >= 128) {
+    error = "FEN too long";
+  }
+  else {
+    parse_FEN_checked(fen, fen_end, &error);
+  }
+
+  if (error) {
+    server_send(session, "error %s %s\n", id, error);
+    return;
+  }
+
+  server_analysis* analysis = (server_analysis*)calloc(1, sizeof(server_analysis));
+
+  analysis->session = session;
+  strcpy(analysis->id, id);
+  memcpy(analysis->fen, fen, fen_end - fen);
+
+  analysis->depth = parse_go_value(fen_end, "depth ");
+  analysis->node_limit = (uint64_t)strtoull(strstr(fen_end, "nodes ") ? strstr(fen_end, "nodes ") + 6 : "0", NULL, 10);
+  analysis->start_time = get_time_ms();
+
+  int movetime = parse_go_value(fen_end, "movetime ");
+  if (movetime > 0) analysis->deadline = analysis->start_time + movetime;
+
+  if (analysis->depth <= 0 || analysis->depth > max_ply - 1) {
+    analysis->depth = (analysis->node_limit || analysis->deadline) ? max_ply - 1 : server_default_depth;
+  }
+
+  analysis->next_depth = 1;
+  analysis->slice_ms = server_slice_ms;
+
+  atomic_fetch_add(&session->references, 1);
+
+  pthread_mutex_lock(&session->mutex);
+  analysis->next_in_session = session->analyses;
+  session->analyses = analysis;
+  pthread_mutex_unlock(&session->mutex);
+
+  server_enqueue(analysis);
+}
+
+// reads the commands of one session
+void* server_session_main(void* arg) {
+  server_session* session = (server_session*)arg;
+
+  FILE* input = fdopen(dup(session->fd), "r");
+  char command[4096];
+
+  while (input && fgets(command, sizeof(command), input)) {
+    command[strcspn(command, "\r\n")] = '\0';
+
+    if (strncmp(command, "analyse ", 8) == 0) {
+      server_parse_analyse(session, command);
+    }
+    else if (strncmp(command, "stop", 4) == 0) {
+      char id[32];
+      server_cancel(session, (sscanf(command + 4, "%31s", id) == 1) ? id : NULL);
+    }
+    else if (strncmp(command, "quit", 4) == 0) {
+      break;
+    }
+    else if (command[0]) {
+      server_send(session, "error - unknown command %s\n", command);
+    }
+  }
+
+  if (input) fclose(input);
+
+  // analyses of a closed session are dropped at their next slice
+  atomic_store(&session->closed, 1);
+  server_cancel(session, NULL);
+  shutdown(session->fd, SHUT_RDWR);
+  server_release(session);
+
+  return NULL;
+}
+
+int server_main(const int argc, char* argv[]) {
+  if (argc < 1) {
+    printf("usage: server <socket path> [threads N] [hash MB] [slice MS]\n");
+    return 1;
+  }
+
+  int threads = 1;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "threads") == 0) threads = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "hash") == 0 && atoi(argv[i + 1]) > 0) init_hash_table(atoi(argv[i + 1]));
+    else if (strcmp(argv[i], "slice") == 0 && atoi(argv[i + 1]) > 0) server_slice_ms = atoi(argv[i + 1]);
+  }
+
+  if (threads < 1) threads = 1;
+  if (threads > max_threads) threads = max_threads;
+
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+
+  if (strlen(argv[0]) >= sizeof(address.sun_path)) {
+    printf("socket path too long\n");
+    return 1;
+  }
+  strcpy(address.sun_path, argv[0]);
+
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(argv[0]);
+
+  if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) || listen(listen_fd, 64)) {
+    printf("can't listen on %s\n", argv[0]);
+    return 1;
+  }
+
+  // analyses only run under their own limits
+  print_search_info = 0;
+  limits = (search_limits){ 0 };
+  stop_time = 0;
+  soft_time_limit = 0;
+
+  pthread_t worker_threads[max_threads];
+  for (int i = 0; i < threads; ++i) pthread_create(&worker_threads[i], NULL, server_worker_main, NULL);
+
+  printf("listening on %s with %d threads\n", argv[0], threads);
+  fflush(stdout);
+
+  while (1) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) continue;
+
+    server_session* session = (server_session*)calloc(1, sizeof(server_session));
+    session->fd = fd;
+    pthread_mutex_init(&session->mutex, NULL);
+    atomic_store(&session->references, 1);
+
+    pthread_t reader;
+    pthread_create(&reader, NULL, server_session_main, session);
+    pthread_detach(reader);
+  }
+
+  return 0;
+}
+
+// =====================
+// Library
+// =====================
+
+/*
+  evaluate_batch and legal_moves_batch (see sara.h). positions are parsed
+  into tiles of position_tile positions stored as structure of arrays: all
+  white pawn bitboards of a tile next to each other and so on, so the
+  evaluation passes run over one piece type of every position at a time,
+  which streams through the cache and lets the compiler vectorize the
+  material pass. tiles are thread local, nothing is allocated per call
+*/
+
+#define position_tile 128
+
+typedef struct {
+  uint64_t pieces[12][position_tile];
+  uint8_t side[position_tile];
+  uint8_t castle[position_tile];
+  uint8_t enpassant[position_tile];
+  uint8_t valid[position_tile];
+} position_tile_soa;
+
+_Thread_local position_tile_soa tile;
+
+// piece square score [piece][pos1D] from white's point of view, material included (kings are tapered per position)
+int piece_square_score[12][64];
+
+pthread_once_t library_once = PTHREAD_ONCE_INIT;
+
+void init_library() {
+  init_tables();
+
+  for (int pos1D = 0; pos1D < 64; ++pos1D) {
+    for (int piece = P; piece <= Q; ++piece) {
+      piece_square_score[piece][pos1D] = positional_score(piece, flip_pos1D(pos1D));
+      piece_square_score[piece + p][pos1D] = -positional_score(piece, pos1D);
+    }
+  }
+}
+
+// parse fens[0 .. count) into the tile, returns the number of invalid ones
+int load_tile(const char* const fens[], const int count) {
+  int invalid = 0;
+
+  for (int i = 0; i < count; ++i) {
+    const char* error = NULL;
+    const char* fen = fens[i] ? fens[i] : "";
+
+    parse_FEN_checked(fen, fen + strlen(fen), &error);
+
+    tile.valid[i] = (error == NULL);
+
+    if (error) {
+      ++invalid;
+      for (int piece = P; piece <= k; ++piece) tile.pieces[piece][i] = 0ULL;
+      continue;
+    }
+
+    for (int piece = P; piece <= k; ++piece) tile.pieces[piece][i] = piece_bitboards[piece];
+    tile.side[i] = side;
+    tile.castle[i] = castle;
+    tile.enpassant[i] = enpassant_pos1D;
+  }
+
+  return invalid;
+}
+
+// set the board of the calling thread to position i of the tile
+void load_tile_position(const int i) {
+  for (int piece = P; piece <= k; ++piece) piece_bitboards[piece] = tile.pieces[piece][i];
+
+  piece_color_mask[white] = piece_bitboards[P] | piece_bitboards[N] | piece_bitboards[B] | piece_bitboards[R] | piece_bitboards[Q] | piece_bitboards[K];
+  piece_color_mask[black] = piece_bitboards[p] | piece_bitboards[n] | piece_bitboards[b] | piece_bitboards[r] | piece_bitboards[q] | piece_bitboards[k];
+  piece_color_mask[white_black] = piece_color_mask[white] | piece_color_mask[black];
+
+  side = tile.side[i];
+  castle = tile.castle[i];
+  enpassant_pos1D = tile.enpassant[i];
+  hash_key = generate_hash_key();
+}
+
+// same score as evaluate() for every position of the tile
+void evaluate_tile(const int count, int out[]) {
+  int scores[position_tile];
+  uint64_t keys[position_tile];
+
+  for (int i = 0; i < count; ++i) scores[i] = 0, keys[i] = 0ULL;
+
+  // queens only have material, the pass over all positions vectorizes, the counts also make the material keys
+  for (int piece = P; piece <= k; ++piece) {
+    const uint64_t* bitboards = tile.pieces[piece];
+    const int piece_score = material_score[piece];
+
+    for (int i = 0; i < count; ++i) {
+      int pieces = popcount(bitboards[i]);
+      scores[i] += piece_score * pieces;
+      keys[i] |= (uint64_t)pieces << (4 * piece);
+    }
+  }
+
+  for (int piece = P; piece <= k; ++piece) {
+    if (piece == Q || piece == q || piece == K || piece == k) continue;
+
+    const uint64_t* bitboards = tile.pieces[piece];
+    const int* square_score = piece_square_score[piece];
+
+    for (int i = 0; i < count; ++i) {
+      uint64_t bitboard = bitboards[i];
+
+      while (bitboard) {
+        scores[i] += square_score[LSB_index(bitboard)];
+        bitboard &= bitboard - 1;
+      }
+    }
+  }
+
+  // phase, imbalance and scaling from the material entry, known endgames need the board
+  for (int i = 0; i < count; ++i) {
+    if (!tile.valid[i]) {
+      out[i] = invalid_position_score;
+      continue;
+    }
+
+    const material_entry* entry = probe_material(keys[i]);
+
+    if (entry->evaluate_endgame || entry->scale_endgame) {
+      load_tile_position(i);
+      out[i] = evaluate();
+      continue;
+    }
+
+    int score = scores[i] + entry->imbalance;
+    score += king_positional_score(flip_pos1D(LSB_index(tile.pieces[K][i])), entry->phase);
+    score -= king_positional_score(LSB_index(tile.pieces[k][i]), entry->phase);
+    score = scale_score(entry, score);
+
+    out[i] = (tile.side[i] == white) ? score : -score;
+  }
+}
+
+int evaluate_batch(const char* const fens[], const int n, int out[]) {
+  pthread_once(&library_once, init_library);
+
+  int invalid = 0;
+
+  for (int start = 0; start < n; start += position_tile) {
+    int count = (n - start < position_tile) ? n - start : position_tile;
+
+    invalid += load_tile(fens + start, count);
+    evaluate_tile(count, out + start);
+  }
+
+  return invalid;
+}
+
+int legal_moves_batch(const char* const fens[], const int n, int moves_out[], int counts[]) {
+  pthread_once(&library_once, init_library);
+
+  int invalid = 0;
+
+  for (int start = 0; start < n; start += position_tile) {
+    int count = (n - start < position_tile) ? n - start : position_tile;
+
+    invalid += load_tile(fens + start, count);
+
+    for (int i = 0; i < count; ++i) {
+      int* legal_moves = moves_out + (size_t)(start + i) * max_legal_moves;
+
+      if (!tile.valid[i]) {
+        counts[start + i] = -1;
+        continue;
+      }
+
+      load_tile_position(i);
+
+      moves move_list[1];
+      move_generation(move_list);
+
+      int legal_count = 0;
+
+      for (int j = 0; j < move_list->count; ++j) {
+        copy_board();
+
+        if (!make_move(move_list->moves[j], all_moves)) continue;
+
+        take_back();
+
+        legal_moves[legal_count++] = move_list->moves[j];
+      }
+
+      counts[start + i] = legal_count;
+    }
+  }
+
+  return invalid;
+}
+
+// =====================
+// Main
+// =====================
+
+#ifndef SARA_LIBRARY
+#ifdef FAT_BINARY
+/*
+  fat binary (make fat): the whole program is also compiled for x86-64-v2,
+  v3 (avx2, bmi2) and v4 (avx512) with main renamed to main_v2 .. main_v4,
+  this generic build picks the newest level the cpu supports at startup
+*/
+int main_v2(int argc, char* argv[]);
+int main_v3(int argc, char* argv[]);
+int main_v4(int argc, char* argv[]);
+#endif
+
+int main(int argc, char* argv[]) {
+#ifdef FAT_BINARY
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("x86-64-v4")) return main_v4(argc, argv);
+  if (__builtin_cpu_supports("x86-64-v3")) return main_v3(argc, argv);
+  if (__builtin_cpu_supports("x86-64-v2")) return main_v2(argc, argv);
+#endif
+
+  init();
+
+  // command line modes, uci otherwise
+  if (argc > 1 && strcmp(argv[1], "batch") == 0) return batch_main(argc - 2, argv + 2);
+  if (argc > 1 && strcmp(argv[1], "selfplay") == 0) return selfplay_main(argc - 2, argv + 2);
+  if (argc > 1 && strcmp(argv[1], "pgnindex") == 0) return pgnindex_main(argc - 2, argv + 2);
+  if (argc > 1 && strcmp(argv[1], "bench") == 0) return bench_main(argc - 2, argv + 2);
+  if (argc > 1 && strcmp(argv[1], "server") == 0) return server_main(argc - 2, argv + 2);
+  if (argc > 1 && strcmp(argv[1], "mate") == 0) return mate_main(argc - 2, argv + 2);
+  if (argc > 1 && strcmp(argv[1], "tbcheck") == 0) return tbcheck_main(argc - 2, argv + 2);
+
+  uci_loop();
 
-  print_attacked_squares(white);
-  
 	return 0;
 }
+#endif
@@ -0,0 +1,27 @@
+#ifndef SARA_H
+#define SARA_H
+
+/*
+  batch api of the engine, for linking it into other programs: build main.c
+  with -DSARA_LIBRARY (leaves out main) and include this header
+
+  every call is thread safe and allocation free, the first call sets up the
+  attack tables. FENs that don't parse (or have the side not to move in
+  check) get invalid_position_score / a move count of -1
+*/
+
+#define invalid_position_score (-1000000)
+
+// moves written per position by legal_moves_batch
+#define max_legal_moves 256
+
+// static evaluation of each position relative to its side to move, returns the number of invalid FENs
+int evaluate_batch(const char* const fens[], const int n, int out[]);
+
+// legal moves of each position: moves_out[i * max_legal_moves ...] and counts[i], returns the number of invalid FENs
+int legal_moves_batch(const char* const fens[], const int n, int moves_out[], int counts[]);
+
+// move in uci notation (e.g. e7e8q), buffer needs 6 chars
+char* move_to_string(const int move, char* buffer);
+
+#endif
@@ -0,0 +1,360 @@
+#include "bitboard.h"
+
+namespace sara {
+
+// =====================
+// Attacks
+// =====================
+
+const int bishop_occupancy_setbits[64] = {
+  6,  5,  5,  5,  5,  5,  5,  6, 
+  5,  5,  5,  5,  5,  5,  5,  5, 
+  5,  5,  7,  7,  7,  7,  5,  5, 
+  5,  5,  7,  9,  9,  7,  5,  5, 
+  5,  5,  7,  9,  9,  7,  5,  5, 
+  5,  5,  7,  7,  7,  7,  5,  5, 
+  5,  5,  5,  5,  5,  5,  5,  5, 
+  6,  5,  5,  5,  5,  5,  5,  6 
+};
+
+const int rook_occupancy_setbits[64] = {
+  12,  11,  11,  11,  11,  11,  11,  12, 
+  11,  10,  10,  10,  10,  10,  10,  11, 
+  11,  10,  10,  10,  10,  10,  10,  11, 
+  11,  10,  10,  10,  10,  10,  10,  11, 
+  11,  10,  10,  10,  10,  10,  10,  11, 
+  11,  10,  10,  10,  10,  10,  10,  11, 
+  11,  10,  10,  10,  10,  10,  10,  11, 
+  12,  11,  11,  11,  11,  11,  11,  12
+};
+
+const bitboard rook_magic_numbers[64] = {
+  0xa8002c000108020ULL,
+  0x6c00049b0002001ULL,
+  0x100200010090040ULL,
+  0x2480041000800801ULL,
+  0x280028004000800ULL,
+  0x900410008040022ULL,
+  0x280020001001080ULL,
+  0x2880002041000080ULL,
+  0xa000800080400034ULL,
+  0x4808020004000ULL,
+  0x2290802004801000ULL,
+  0x411000d00100020ULL,
+  0x402800800040080ULL,
+  0xb000401004208ULL,
+  0x2409000100040200ULL,
+  0x1002100004082ULL,
+  0x22878001e24000ULL,
+  0x1090810021004010ULL,
+  0x801030040200012ULL,
+  0x500808008001000ULL,
+  0xa08018014000880ULL,
+  0x8000808004000200ULL,
+  0x201008080010200ULL,
+  0x801020000441091ULL,
+  0x800080204005ULL,
+  0x1040200040100048ULL,
+  0x120200402082ULL,
+  0xd14880480100080ULL,
+  0x12040280080080ULL,
+  0x100040080020080ULL,
+  0x9020010080800200ULL,
+  0x813241200148449ULL,
+  0x491604001800080ULL,
+  0x100401000402001ULL,
+  0x4820010021001040ULL,
+  0x400402202000812ULL,
+  0x209009005000802ULL,
+  0x810800601800400ULL,
+  0x4301083214000150ULL,
+  0x204026458e001401ULL,
+  0x40204000808000ULL,
+  0x8001008040010020ULL,
+  0x8410820820420010ULL,
+  0x1003001000090020ULL,
+  0x804040008008080ULL,
+  0x12000810020004ULL,
+  0x1000100200040208ULL,
+  0x430000a044020001ULL,
+  0x280009023410300ULL,
+  0xe0100040002240ULL,
+  0x200100401700ULL,
+  0x2244100408008080ULL,
+  0x8000400801980ULL,
+  0x2000810040200ULL,
+  0x8010100228810400ULL,
+  0x2000009044210200ULL,
+  0x4080008040102101ULL,
+  0x40002080411d01ULL,
+  0x2005524060000901ULL,
+  0x502001008400422ULL,
+  0x489a000810200402ULL,
+  0x1004400080a13ULL,
+  0x4000011008020084ULL,
+  0x26002114058042ULL
+};
+
+const bitboard bishop_magic_numbers[64] = {
+  0x89a1121896040240ULL,
+  0x2004844802002010ULL,
+  0x2068080051921000ULL,
+  0x62880a0220200808ULL,
+  0x4042004000000ULL,
+  0x100822020200011ULL,
+  0xc00444222012000aULL,
+  0x28808801216001ULL,
+  0x400492088408100ULL,
+  0x201c401040c0084ULL,
+  0x840800910a0010ULL,
+  0x82080240060ULL,
+  0x2000840504006000ULL,
+  0x30010c4108405004ULL,
+  0x1008005410080802ULL,
+  0x8144042209100900ULL,
+  0x208081020014400ULL,
+  0x4800201208ca00ULL,
+  0xf18140408012008ULL,
+  0x1004002802102001ULL,
+  0x841000820080811ULL,
+  0x40200200a42008ULL,
+  0x800054042000ULL,
+  0x88010400410c9000ULL,
+  0x520040470104290ULL,
+  0x1004040051500081ULL,
+  0x2002081833080021ULL,
+  0x400c00c010142ULL,
+  0x941408200c002000ULL,
+  0x658810000806011ULL,
+  0x188071040440a00ULL,
+  0x4800404002011c00ULL,
+  0x104442040404200ULL,
+  0x511080202091021ULL,
+  0x4022401120400ULL,
+  0x80c0040400080120ULL,
+  0x8040010040820802ULL,
+  0x480810700020090ULL,
+  0x102008e00040242ULL,
+  0x809005202050100ULL,
+  0x8002024220104080ULL,
+  0x431008804142000ULL,
+  0x19001802081400ULL,
+  0x200014208040080ULL,
+  0x3308082008200100ULL,
+  0x41010500040c020ULL,
+  0x4012020c04210308ULL,
+  0x208220a202004080ULL,
+  0x111040120082000ULL,
+  0x6803040141280a00ULL,
+  0x2101004202410000ULL,
+  0x8200000041108022ULL,
+  0x21082088000ULL,
+  0x2410204010040ULL,
+  0x40100400809000ULL,
+  0x822088220820214ULL,
+  0x40808090012004ULL,
+  0x910224040218c9ULL,
+  0x402814422015008ULL,
+  0x90014004842410ULL,
+  0x1000042304105ULL,
+  0x10008830412a00ULL,
+  0x2520081090008908ULL,
+  0x40102000a0a60140ULL
+};
+
+bitboard bishop_attacks[64][512];
+bitboard rook_attacks[64][4096];
+
+// fill the magic table of one slider on every square, every subset of the
+// occupancy mask is visited with the carry rippler (subset - mask) & mask
+template <int table_size>
+static void init_slider_attacks(bitboard attacks[64][table_size], const std::array<bitboard, 64>& masks,
+                                const bitboard magic_numbers[64], const int occupancy_setbits[64],
+                                bitboard (*mask_attacks)(square, bitboard)) {
+  for (square pos1D = a1; pos1D < out_of_bounds_pos1D; ++pos1D) {
+    bitboard occupancy = 0ULL;
+
+    do {
+      const int hash_index = int((occupancy * magic_numbers[pos1D]) >> (64 - occupancy_setbits[pos1D]));
+      attacks[pos1D][hash_index] = mask_attacks(pos1D, occupancy);
+      occupancy = (occupancy - masks[pos1D]) & masks[pos1D];
+    } while (occupancy);
+  }
+}
+
+void init_attacks() {
+  init_slider_attacks<512>(bishop_attacks, bishop_masks, bishop_magic_numbers, bishop_occupancy_setbits, mask_bishop_attacks_given_occupancy);
+  init_slider_attacks<4096>(rook_attacks, rook_masks, rook_magic_numbers, rook_occupancy_setbits, mask_rook_attacks_given_occupancy);
+}
+
+// =====================
+// Board
+// =====================
+
+// get refer value of ascii piece, no_piece for anything else
+static piece ascii_piece_refer_value(const char c) {
+  constexpr char ascii_pieces[] = "PNBRQKpnbrqk";
+
+  for (piece pc = P; pc < no_piece; ++pc) {
+    if (ascii_pieces[pc] == c) return pc;
+  }
+  return no_piece;
+}
+
+// occupancy masks from the piece bitboards
+static void update_color_masks(board& pos) {
+  pos.piece_color_mask[white] = pos.piece_color_mask[black] = 0ULL;
+
+  for (piece pc = P; pc <= K; ++pc) pos.piece_color_mask[white] |= pos.piece_bitboards[pc];
+  for (piece pc = p; pc <= k; ++pc) pos.piece_color_mask[black] |= pos.piece_bitboards[pc];
+
+  pos.piece_color_mask[white_black] = pos.piece_color_mask[white] | pos.piece_color_mask[black];
+}
+
+bool parse_FEN(board& pos, const char* fen) {
+  pos = board();
+
+  // pieces, rank 8 first
+  int rank = 7, file = 0;
+
+  for (; *fen && *fen != ' '; ++fen) {
+    if (*fen == '/') {
+      if (file != 8 || rank == 0) return pos = board(), false;
+      --rank;
+      file = 0;
+    }
+    else if (*fen >= '1' && *fen <= '8') {
+      file += *fen - '0';
+      if (file > 8) return pos = board(), false;
+    }
+    else {
+      const piece pc = ascii_piece_refer_value(*fen);
+      if (pc == no_piece || file > 7) return pos = board(), false;
+      set_bit(pos.piece_bitboards[pc], square(rank * 8 + file));
+      ++file;
+    }
+  }
+
+  // all eight ranks, each one complete
+  if (rank != 0 || file != 8) return pos = board(), false;
+
+  // side to move
+  if (*fen++ != ' ' || (*fen != 'w' && *fen != 'b')) return pos = board(), false;
+  pos.side = (*fen++ == 'w') ? white : black;
+
+  // castle rights
+  if (*fen++ != ' ') return pos = board(), false;
+  for (; *fen && *fen != ' '; ++fen) {
+    switch (*fen) {
+      case 'K': pos.castle |= wck; break;
+      case 'Q': pos.castle |= wcq; break;
+      case 'k': pos.castle |= bck; break;
+      case 'q': pos.castle |= bcq; break;
+      case '-': break;
+      default: return pos = board(), false;
+    }
+  }
+
+  // en passant
+  if (*fen++ != ' ') return pos = board(), false;
+  if (*fen >= 'a' && *fen <= 'h' && (fen[1] == '3' || fen[1] == '6')) {
+    pos.enpassant_pos1D = square((fen[1] - '1') * 8 + (fen[0] - 'a'));
+  }
+  else if (*fen != '-') {
+    return pos = board(), false;
+  }
+
+  // exactly one king each
+  if (popcount(pos.piece_bitboards[K]) != 1 || popcount(pos.piece_bitboards[k]) != 1) return pos = board(), false;
+
+  update_color_masks(pos);
+  return true;
+}
+
+/*
+  castling rights are updated with castle &= castling_rights[square] for both
+  the source and the destination square of every move
+*/
+static constexpr int castling_rights[64] = {
+  13, 15, 15, 15, 12, 15, 15, 14,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+  15, 15, 15, 15, 15, 15, 15, 15,
+   7, 15, 15, 15,  3, 15, 15, 11
+};
+
+// make move of side on pos, returns false if it leaves the own king in check (pos is then garbage)
+template <color side>
+static bool make_move(board& pos, const int move) {
+  const square source = get_move_source(move);
+  const square destination = get_move_destination(move);
+  const piece pc = get_move_piece(move);
+  const int promoted = get_move_promoted(move);
+  bitboard* pieces = pos.piece_bitboards;
+
+  // remove captured piece
+  if (get_move_capture(move) && !get_move_enpassant(move)) {
+    for (piece captured = make_piece<~side>(P); captured <= make_piece<~side>(K); ++captured) {
+      reset_bit(pieces[captured], destination);
+    }
+  }
+
+  // move piece, a promotion lands as the promoted piece
+  reset_bit(pieces[pc], source);
+  set_bit(pieces[promoted ? piece(promoted) : pc], destination);
+
+  // enpassant capture removes the pawn behind the destination square
+  if (get_move_enpassant(move)) reset_bit(pieces[make_piece<~side>(P)], destination - pawn_push<side>);
+
+  // double pawn push sets enpassant square
+  pos.enpassant_pos1D = get_move_double_push(move) ? destination - pawn_push<side> : out_of_bounds_pos1D;
+
+  // move rook when castling
+  if (get_move_castling(move)) {
+    constexpr piece rook = make_piece<side>(R);
+    const bool king_side = file_of(destination) == 6;
+    const square rook_source = king_side ? destination + 1 : destination - 2;
+    const square rook_destination = king_side ? destination - 1 : destination + 1;
+
+    reset_bit(pieces[rook], rook_source);
+    set_bit(pieces[rook], rook_destination);
+  }
+
+  // update castling rights
+  pos.castle &= castling_rights[source] & castling_rights[destination];
+
+  update_color_masks(pos);
+  pos.side = ~side;
+
+  // king of the side that just moved must not be left in check
+  return !in_check<side>(pos);
+}
+
+bool make_move(board& pos, const int move) {
+  const board copy = pos;
+
+  if (pos.side == white ? make_move<white>(pos, move) : make_move<black>(pos, move)) return true;
+
+  pos = copy;
+  return false;
+}
+
+uint64_t perft(const board& pos, const int depth) {
+  if (depth == 0) return 1;
+
+  move_list list;
+  generate_moves(pos, list);
+
+  uint64_t nodes = 0;
+  for (const int move : list) {
+    board next = pos;
+    if (!make_move(next, move)) continue;
+    nodes += (depth == 1) ? 1 : perft(next, depth - 1);
+  }
+  return nodes;
+}
+
+} // namespace sara
@@ -0,0 +1,369 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <array>
+#include <cassert>
+
+#include "types.h"
+
+namespace sara {
+
+// =====================
+// Bit Operations
+// =====================
+
+// magic numbers for edges of the board
+constexpr bitboard rank_1 = 255ULL;
+constexpr bitboard rank_8 = 18374686479671623680ULL;
+constexpr bitboard file_a = 72340172838076673ULL;
+constexpr bitboard file_b = 144680345676153346ULL;
+constexpr bitboard file_g = 4629771061636907072ULL;
+constexpr bitboard file_h = 9259542123273814144ULL;
+
+constexpr bitboard square_bitboard(const square pos1D) { return 1ULL << pos1D; }
+
+// get i'th bit of bitboard, a shift and a mask instead of a compare and branch
+constexpr int get_bit(const bitboard bb, const square pos1D) { return int((bb >> pos1D) & 1); }
+
+// set i'th bit of bitboard
+constexpr void set_bit(bitboard& bb, const square pos1D) { bb |= square_bitboard(pos1D); }
+
+// flip i'th bit of bitboard
+constexpr void flip_bit(bitboard& bb, const square pos1D) { bb ^= square_bitboard(pos1D); }
+
+// reset i'th bit of bitboard to 0
+constexpr void reset_bit(bitboard& bb, const square pos1D) { bb &= ~square_bitboard(pos1D); }
+
+// count the number of set bits
+constexpr int popcount(const bitboard bb) { return __builtin_popcountll(bb); }
+
+// get LSB index, the board must not be empty (checked in debug builds, a single tzcnt/bsf otherwise)
+constexpr square LSB_index(const bitboard bb) {
+  assert(bb != 0);
+  return square(__builtin_ctzll(bb));
+}
+
+/*
+  LSB index that is also defined for an empty board, which gives
+  out_of_bounds_pos1D instead of the engine's -1
+
+  bit 63 is forced on so ctz never sees 0, for an empty board it finds
+  63 and the (bb == 0) term moves it to 64, no branch either way
+*/
+constexpr square LSB_index_or_none(const bitboard bb) {
+  return square(__builtin_ctzll(bb | (1ULL << 63)) + (bb == 0));
+}
+
+// remove the LSB and return its index
+constexpr square pop_LSB(bitboard& bb) {
+  const square pos1D = LSB_index(bb);
+  bb &= bb - 1;
+  return pos1D;
+}
+
+/*
+  iterate the set squares of a bitboard, LSB first
+
+  for (square pos1D : squares(bb)) { .. }
+*/
+class squares {
+ public:
+  class iterator {
+   public:
+    constexpr explicit iterator(const bitboard bb) : bb_(bb) {}
+    constexpr square operator*() const { return LSB_index(bb_); }
+    constexpr iterator& operator++() { bb_ &= bb_ - 1; return *this; }
+    constexpr bool operator!=(const iterator& other) const { return bb_ != other.bb_; }
+
+   private:
+    bitboard bb_;
+  };
+
+  constexpr explicit squares(const bitboard bb) : bb_(bb) {}
+  constexpr iterator begin() const { return iterator(bb_); }
+  constexpr iterator end() const { return iterator(0); }
+
+ private:
+  bitboard bb_;
+};
+
+// =====================
+// Attacks
+// =====================
+
+// get pawn attacks mask
+constexpr bitboard mask_pawn_attacks(const color side, const square pos1D) {
+  const bitboard bb = square_bitboard(pos1D);
+
+  // white pawns
+  if (side == white) return ((bb & ~file_h) << 9) | ((bb & ~file_a) << 7);
+
+  // black pawns
+  return ((bb & ~file_h) >> 7) | ((bb & ~file_a) >> 9);
+}
+
+// get knight attacks mask
+constexpr bitboard mask_knight_attacks(const square pos1D) {
+  const bitboard bb = square_bitboard(pos1D);
+
+  return (((bb << 15) | (bb >> 17)) & ~file_h) |
+         (((bb << 17) | (bb >> 15)) & ~file_a) |
+         (((bb << 6) | (bb >> 10)) & ~(file_h | file_g)) |
+         (((bb << 10) | (bb >> 6)) & ~(file_a | file_b));
+}
+
+// get king attacks mask
+constexpr bitboard mask_king_attacks(const square pos1D) {
+  const bitboard bb = square_bitboard(pos1D);
+
+  return (bb << 8) | (bb >> 8) |
+         (((bb << 7) | (bb >> 9) | (bb >> 1)) & ~file_h) |
+         (((bb << 9) | (bb >> 7) | (bb << 1)) & ~file_a);
+}
+
+// slider rays from pos1D, stopping at the first occupied square,
+// with edge_only set the rays stop one short of the edge (occupancy masks)
+constexpr bitboard mask_slider(const square pos1D, const bitboard occupancy, const int directions[4][2], const bool edge_only) {
+  bitboard attacks = 0ULL;
+
+  for (int direction = 0; direction < 4; ++direction) {
+    const int rank_step = directions[direction][0];
+    const int file_step = directions[direction][1];
+
+    for (int rank = rank_of(pos1D) + rank_step, file = file_of(pos1D) + file_step;
+         rank >= 0 && rank < 8 && file >= 0 && file < 8; rank += rank_step, file += file_step) {
+      // the last square of the ray never changes the attacks
+      const int next_rank = rank + rank_step;
+      const int next_file = file + file_step;
+      if (edge_only && (next_rank < 0 || next_rank > 7 || next_file < 0 || next_file > 7)) break;
+
+      const bitboard bb = 1ULL << (rank * 8 + file);
+      attacks |= bb;
+      if (bb & occupancy) break;
+    }
+  }
+
+  return attacks;
+}
+
+constexpr int bishop_directions[4][2] = { { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+constexpr int rook_directions[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+
+constexpr bitboard mask_bishop_occupancy(const square pos1D) { return mask_slider(pos1D, 0ULL, bishop_directions, true); }
+constexpr bitboard mask_rook_occupancy(const square pos1D) { return mask_slider(pos1D, 0ULL, rook_directions, true); }
+
+constexpr bitboard mask_bishop_attacks_given_occupancy(const square pos1D, const bitboard occupancy) {
+  return mask_slider(pos1D, occupancy, bishop_directions, false);
+}
+
+constexpr bitboard mask_rook_attacks_given_occupancy(const square pos1D, const bitboard occupancy) {
+  return mask_slider(pos1D, occupancy, rook_directions, false);
+}
+
+// fill a table of 64 masks at compile time
+template <typename mask_function>
+constexpr std::array<bitboard, 64> precompute(const mask_function mask) {
+  std::array<bitboard, 64> table = {};
+  for (square pos1D = a1; pos1D < out_of_bounds_pos1D; ++pos1D) table[pos1D] = mask(pos1D);
+  return table;
+}
+
+// leaper and occupancy tables are built by the compiler, only the magic tables need init_attacks()
+constexpr std::array<bitboard, 64> pawn_attacks[2] = {
+  precompute([](const square pos1D) { return mask_pawn_attacks(white, pos1D); }),
+  precompute([](const square pos1D) { return mask_pawn_attacks(black, pos1D); })
+};
+constexpr std::array<bitboard, 64> knight_attacks = precompute(mask_knight_attacks);
+constexpr std::array<bitboard, 64> king_attacks = precompute(mask_king_attacks);
+constexpr std::array<bitboard, 64> bishop_masks = precompute(mask_bishop_occupancy);
+constexpr std::array<bitboard, 64> rook_masks = precompute(mask_rook_occupancy);
+
+static_assert(knight_attacks[a1] == (square_bitboard(b3) | square_bitboard(c2)));
+static_assert(king_attacks[h8] == (square_bitboard(g8) | square_bitboard(g7) | square_bitboard(h7)));
+static_assert(pawn_attacks[black][a7] == square_bitboard(b6));
+static_assert(popcount(rook_masks[a1]) == 12 && popcount(bishop_masks[d4]) == 9);
+
+extern const int bishop_occupancy_setbits[64];
+extern const int rook_occupancy_setbits[64];
+extern const bitboard bishop_magic_numbers[64];
+extern const bitboard rook_magic_numbers[64];
+
+// bishop attacks table [pos1D][occupancies]
+extern bitboard bishop_attacks[64][512];
+
+// rook attacks table [pos1D][occupancies]
+extern bitboard rook_attacks[64][4096];
+
+// fill the magic bitboard tables, call once before any slider lookup
+void init_attacks();
+
+// get bishop attacks
+inline bitboard get_bishop_attacks(const square pos1D, const bitboard occupancy) {
+  const bitboard rel_occupancy = occupancy & bishop_masks[pos1D];
+  return bishop_attacks[pos1D][(rel_occupancy * bishop_magic_numbers[pos1D]) >> (64 - bishop_occupancy_setbits[pos1D])];
+}
+
+// get rook attacks
+inline bitboard get_rook_attacks(const square pos1D, const bitboard occupancy) {
+  const bitboard rel_occupancy = occupancy & rook_masks[pos1D];
+  return rook_attacks[pos1D][(rel_occupancy * rook_magic_numbers[pos1D]) >> (64 - rook_occupancy_setbits[pos1D])];
+}
+
+// get queen attacks
+inline bitboard get_queen_attacks(const square pos1D, const bitboard occupancy) {
+  return get_bishop_attacks(pos1D, occupancy) | get_rook_attacks(pos1D, occupancy);
+}
+
+// is square attacked by the given side, the piece choice is made by the compiler
+template <color side>
+inline bool is_square_attacked(const board& pos, const square pos1D) {
+  const bitboard* pieces = pos.piece_bitboards;
+  const bitboard occupancy = pos.piece_color_mask[white_black];
+
+  // a pawn of side attacks pos1D if a pawn of the other side on pos1D would attack it
+  if (pawn_attacks[~side][pos1D] & pieces[make_piece<side>(P)]) return true;
+  if (knight_attacks[pos1D] & pieces[make_piece<side>(N)]) return true;
+  if (king_attacks[pos1D] & pieces[make_piece<side>(K)]) return true;
+  if (get_bishop_attacks(pos1D, occupancy) & (pieces[make_piece<side>(B)] | pieces[make_piece<side>(Q)])) return true;
+  if (get_rook_attacks(pos1D, occupancy) & (pieces[make_piece<side>(R)] | pieces[make_piece<side>(Q)])) return true;
+
+  return false;
+}
+
+inline bool is_square_attacked(const board& pos, const square pos1D, const color side) {
+  return (side == white) ? is_square_attacked<white>(pos, pos1D) : is_square_attacked<black>(pos, pos1D);
+}
+
+// is the king of side in check
+template <color side>
+inline bool in_check(const board& pos) {
+  return is_square_attacked<~side>(pos, LSB_index(pos.piece_bitboards[make_piece<side>(K)]));
+}
+
+// =====================
+// Move Generation
+// =====================
+
+// add all four promotions of a pawn move
+template <color side>
+inline void add_promotions(move_list& list, const square source, const square destination, const int capture) {
+  for (const piece promoted : { Q, R, B, N }) {
+    list.add(encode_move(source, destination, make_piece<side>(P), make_piece<side>(promoted), capture, 0, 0, 0));
+  }
+}
+
+// add quiet moves and captures of a non pawn piece given its attacks mask
+template <color side>
+inline void add_piece_moves(const board& pos, move_list& list, const piece pc, const square source, const bitboard attacks) {
+  for (const square destination : squares(attacks & ~pos.piece_color_mask[white_black])) {
+    list.add(encode_move(source, destination, pc, 0, 0, 0, 0, 0));
+  }
+  for (const square destination : squares(attacks & pos.piece_color_mask[~side])) {
+    list.add(encode_move(source, destination, pc, 0, 1, 0, 0, 0));
+  }
+}
+
+// castle to one side if the squares between king and rook are empty and the king doesn't pass an attacked square
+template <color side, int right, square king_to, square passed, bitboard between>
+inline void add_castling(const board& pos, move_list& list) {
+  constexpr square king_from = (side == white) ? e1 : e8;
+
+  if ((pos.castle & right) && !(pos.piece_color_mask[white_black] & between) &&
+      !is_square_attacked<~side>(pos, king_from) && !is_square_attacked<~side>(pos, passed)) {
+    list.add(encode_move(king_from, king_to, make_piece<side>(K), 0, 0, 0, 0, 1));
+  }
+}
+
+// generate all pseudo legal moves of side (legality is checked by make_move)
+template <color side>
+void generate_moves(const board& pos, move_list& list) {
+  constexpr piece pawn = make_piece<side>(P);
+  constexpr bitboard promotion_rank = (side == white) ? (rank_8 >> 8) : (rank_1 << 8);
+  constexpr bitboard double_push_rank = (side == white) ? (rank_1 << 8) : (rank_8 >> 8);
+
+  const bitboard occupancy = pos.piece_color_mask[white_black];
+  const bitboard enemies = pos.piece_color_mask[~side];
+
+  list.count = 0;
+
+  // pawns
+  for (const square source : squares(pos.piece_bitboards[pawn])) {
+    const square destination = source + pawn_push<side>;
+    const bool promotes = get_bit(promotion_rank, source);
+
+    // quiet pawn moves
+    if (!get_bit(occupancy, destination)) {
+      if (promotes) {
+        add_promotions<side>(list, source, destination, 0);
+      }
+      else {
+        list.add(encode_move(source, destination, pawn, 0, 0, 0, 0, 0));
+
+        if (get_bit(double_push_rank, source) && !get_bit(occupancy, destination + pawn_push<side>)) {
+          list.add(encode_move(source, destination + pawn_push<side>, pawn, 0, 0, 1, 0, 0));
+        }
+      }
+    }
+
+    // pawn captures
+    for (const square target : squares(pawn_attacks[side][source] & enemies)) {
+      if (promotes) add_promotions<side>(list, source, target, 1);
+      else list.add(encode_move(source, target, pawn, 0, 1, 0, 0, 0));
+    }
+
+    // enpassant capture
+    if (pos.enpassant_pos1D != out_of_bounds_pos1D && get_bit(pawn_attacks[side][source], pos.enpassant_pos1D)) {
+      list.add(encode_move(source, pos.enpassant_pos1D, pawn, 0, 1, 0, 1, 0));
+    }
+  }
+
+  // castling
+  if (side == white) {
+    add_castling<white, wck, g1, f1, square_bitboard(f1) | square_bitboard(g1)>(pos, list);
+    add_castling<white, wcq, c1, d1, square_bitboard(b1) | square_bitboard(c1) | square_bitboard(d1)>(pos, list);
+  }
+  else {
+    add_castling<black, bck, g8, f8, square_bitboard(f8) | square_bitboard(g8)>(pos, list);
+    add_castling<black, bcq, c8, d8, square_bitboard(b8) | square_bitboard(c8) | square_bitboard(d8)>(pos, list);
+  }
+
+  // knights, bishops, rooks, queens and king
+  for (const square source : squares(pos.piece_bitboards[make_piece<side>(N)])) {
+    add_piece_moves<side>(pos, list, make_piece<side>(N), source, knight_attacks[source]);
+  }
+  for (const square source : squares(pos.piece_bitboards[make_piece<side>(B)])) {
+    add_piece_moves<side>(pos, list, make_piece<side>(B), source, get_bishop_attacks(source, occupancy));
+  }
+  for (const square source : squares(pos.piece_bitboards[make_piece<side>(R)])) {
+    add_piece_moves<side>(pos, list, make_piece<side>(R), source, get_rook_attacks(source, occupancy));
+  }
+  for (const square source : squares(pos.piece_bitboards[make_piece<side>(Q)])) {
+    add_piece_moves<side>(pos, list, make_piece<side>(Q), source, get_queen_attacks(source, occupancy));
+  }
+  for (const square source : squares(pos.piece_bitboards[make_piece<side>(K)])) {
+    add_piece_moves<side>(pos, list, make_piece<side>(K), source, king_attacks[source]);
+  }
+}
+
+// generate moves for the side to move of pos
+inline void generate_moves(const board& pos, move_list& list) {
+  if (pos.side == white) generate_moves<white>(pos, list);
+  else generate_moves<black>(pos, list);
+}
+
+// =====================
+// Board
+// =====================
+
+// set up the board from a FEN string, returns false (board left empty) on a malformed FEN
+bool parse_FEN(board& pos, const char* fen);
+
+// make move on board, returns false (and leaves the board untouched) if the move is illegal
+bool make_move(board& pos, int move);
+
+// number of leaf nodes of the legal move tree to depth
+uint64_t perft(const board& pos, int depth);
+
+} // namespace sara
+
+#endif
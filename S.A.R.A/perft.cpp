@@ -0,0 +1,81 @@
+/*
+  perft check of the bitboard core: the standard perft positions must give
+  the exact node counts and malformed FENs must be rejected
+
+    g++ -std=c++17 -O2 bitboard.cpp perft.cpp -o perft && ./perft
+    g++ -std=c++17 -O1 -g -fsanitize=address,undefined bitboard.cpp perft.cpp -o perft && ./perft
+
+  prints one line per check, returns 1 if any of them failed
+*/
+
+#include <chrono>
+#include <cstdio>
+
+#include "bitboard.h"
+
+using namespace sara;
+
+struct perft_position {
+  const char* fen;
+  int depth;
+  uint64_t nodes;
+};
+
+static constexpr perft_position perft_positions[] = {
+  { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609 },
+  { "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603 },
+  { "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624 },
+  { "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333 },
+  { "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487 },
+  { "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594 }
+};
+
+static constexpr const char* malformed_fens[] = {
+  "k7/K7 w - - 0 1",
+  "k7/8/8/8/8/8/8/K6 w - - 0 1",
+  "k7/8/8/8/8/8/8/8/K7 w - - 0 1",
+  "k8/8/8/8/8/8/8/K7 w - - 0 1",
+  "k7/8/8/8/8/8/8/K7 x - - 0 1",
+  "k7/8/8/8/8/8/8/K7 w X - 0 1",
+  "k7/8/8/8/8/8/8/K7 w - e5 0 1",
+  "8/8/8/8/8/8/8/K7 w - - 0 1",
+  ""
+};
+
+int main() {
+  init_attacks();
+
+  int failures = 0;
+
+  for (const perft_position& position : perft_positions) {
+    board pos;
+
+    if (!parse_FEN(pos, position.fen)) {
+      printf("fail  can't parse  %s\n", position.fen);
+      ++failures;
+      continue;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t nodes = perft(pos, position.depth);
+    const auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    const bool ok = nodes == position.nodes;
+    if (!ok) ++failures;
+
+    printf("%s  depth %d nodes %llu expected %llu time %lld ms  %s\n", ok ? "ok  " : "fail", position.depth,
+           (unsigned long long)nodes, (unsigned long long)position.nodes, (long long)time, position.fen);
+  }
+
+  for (const char* fen : malformed_fens) {
+    board pos;
+
+    const bool ok = !parse_FEN(pos, fen);
+    if (!ok) ++failures;
+
+    printf("%s  rejected  \"%s\"\n", ok ? "ok  " : "fail", fen);
+  }
+
+  printf("%d failed\n", failures);
+  return failures ? 1 : 0;
+}
@@ -1,4 +1,102 @@
 #ifndef TYPES_H
 #define TYPES_H
 
-#endif
\ No newline at end of file
+#include <cstdint>
+
+namespace sara {
+
+using bitboard = uint64_t;
+
+// globally white -> 0 and black -> 1
+enum color : int { white, black, white_black };
+
+// the other side, resolved at compile time when the side is a template argument
+constexpr color operator~(const color side) { return color(side ^ 1); }
+
+// board ranks inverted so that a1 gets 0 and b1 gets 1 and so on ..
+enum square : int {
+  a1, b1, c1, d1, e1, f1, g1, h1,
+  a2, b2, c2, d2, e2, f2, g2, h2,
+  a3, b3, c3, d3, e3, f3, g3, h3,
+  a4, b4, c4, d4, e4, f4, g4, h4,
+  a5, b5, c5, d5, e5, f5, g5, h5,
+  a6, b6, c6, d6, e6, f6, g6, h6,
+  a7, b7, c7, d7, e7, f7, g7, h7,
+  a8, b8, c8, d8, e8, f8, g8, h8, out_of_bounds_pos1D
+};
+
+constexpr square operator+(const square pos1D, const int offset) { return square(int(pos1D) + offset); }
+constexpr square operator-(const square pos1D, const int offset) { return square(int(pos1D) - offset); }
+constexpr square& operator++(square& pos1D) { return pos1D = square(int(pos1D) + 1); }
+
+constexpr int rank_of(const square pos1D) { return pos1D >> 3; }
+constexpr int file_of(const square pos1D) { return pos1D & 7; }
+
+// piece int refer value
+enum piece : int { P, N, B, R, Q, K, p, n, b, r, q, k, no_piece };
+
+// piece of the given color, e.g. make_piece<black>(N) == n
+template <color side>
+constexpr piece make_piece(const piece white_piece) { return piece(white_piece + 6 * side); }
+
+constexpr piece& operator++(piece& pc) { return pc = piece(int(pc) + 1); }
+
+// castling rights
+enum castling : int { wck = 1, wcq = 2, bck = 4, bcq = 8 };
+
+// pawn push direction of a side
+template <color side>
+constexpr int pawn_push = (side == white) ? 8 : -8;
+
+/*
+  a move is packed into a single int, same layout as the engine
+
+  0000 0000 0000 0000 0011 1111    source square       0x3f
+  0000 0000 0000 1111 1100 0000    destination square  0xfc0
+  0000 0000 1111 0000 0000 0000    piece               0xf000
+  0000 1111 0000 0000 0000 0000    promoted piece      0xf0000
+  0001 0000 0000 0000 0000 0000    capture flag        0x100000
+  0010 0000 0000 0000 0000 0000    double push flag    0x200000
+  0100 0000 0000 0000 0000 0000    enpassant flag      0x400000
+  1000 0000 0000 0000 0000 0000    castling flag       0x800000
+*/
+constexpr int encode_move(const square source, const square destination, const piece pc, const int promoted,
+                          const int capture, const int double_push, const int enpassant, const int castling) {
+  return source | (destination << 6) | (pc << 12) | (promoted << 16) |
+         (capture << 20) | (double_push << 21) | (enpassant << 22) | (castling << 23);
+}
+
+constexpr square get_move_source(const int move) { return square(move & 0x3f); }
+constexpr square get_move_destination(const int move) { return square((move & 0xfc0) >> 6); }
+constexpr piece get_move_piece(const int move) { return piece((move & 0xf000) >> 12); }
+constexpr int get_move_promoted(const int move) { return (move & 0xf0000) >> 16; }
+constexpr int get_move_capture(const int move) { return move & 0x100000; }
+constexpr int get_move_double_push(const int move) { return move & 0x200000; }
+constexpr int get_move_enpassant(const int move) { return move & 0x400000; }
+constexpr int get_move_castling(const int move) { return move & 0x800000; }
+
+// move list
+struct move_list {
+  int moves[256];
+  int count = 0;
+
+  void add(const int move) { moves[count++] = move; }
+  const int* begin() const { return moves; }
+  const int* end() const { return moves + count; }
+};
+
+// board state, passed around by value instead of the engine's thread local globals
+struct board {
+  bitboard piece_bitboards[12] = {};
+
+  // white black white_black
+  bitboard piece_color_mask[3] = {};
+
+  color side = white;
+  square enpassant_pos1D = out_of_bounds_pos1D;
+  int castle = 0;
+};
+
+} // namespace sara
+
+#endif